@@ -79,6 +79,19 @@ std::optional<std::string> AndingFilter::stringValueRestrictionFor(
     return {};
 }
 
+std::optional<std::string> AndingFilter::requiredSubstringFor(
+    const std::string &column_name) const {
+    std::optional<std::string> result;
+    for (const auto &filter : _subfilters) {
+        if (auto text = filter->requiredSubstringFor(column_name)) {
+            if (!result || text->size() > result->size()) {
+                result = text;
+            }
+        }
+    }
+    return result;
+}
+
 std::optional<int32_t> AndingFilter::greatestLowerBoundFor(
     const std::string &column_name,
     std::chrono::seconds timezone_offset) const {
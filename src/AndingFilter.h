@@ -51,6 +51,8 @@ public:
         std::function<bool(const Column &)> predicate) const override;
     [[nodiscard]] std::optional<std::string> stringValueRestrictionFor(
         const std::string &column_name) const override;
+    [[nodiscard]] std::optional<std::string> requiredSubstringFor(
+        const std::string &column_name) const override;
     [[nodiscard]] std::optional<int32_t> greatestLowerBoundFor(
         const std::string &column_name,
         std::chrono::seconds timezone_offset) const override;
@@ -0,0 +1,62 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "BloomFilter.h"
+#include <functional>
+
+namespace {
+constexpr size_t bits_per_element = 16;
+}  // namespace
+
+BloomFilter::BloomFilter(size_t expected_elements) {
+    size_t num_bits = 64;
+    while (num_bits < expected_elements * bits_per_element) {
+        num_bits *= 2;
+    }
+    _bits.resize(num_bits / 64);
+    _mask = num_bits - 1;
+}
+
+// Double hashing: The bits are h1, h1 + h2, h1 + 2 * h2, ...
+template <typename F>
+void BloomFilter::forEachBit(std::string_view str, F f) const {
+    uint64_t h1 = std::hash<std::string_view>{}(str);
+    uint64_t h2 = ((h1 >> 32) | (h1 << 32)) | 1U;
+    for (size_t i = 0; i < num_hashes; ++i) {
+        f((h1 + i * h2) & _mask);
+    }
+}
+
+void BloomFilter::add(std::string_view str) {
+    forEachBit(str,
+               [this](size_t bit) { _bits[bit / 64] |= 1ULL << bit % 64; });
+}
+
+bool BloomFilter::mightContain(std::string_view str) const {
+    bool result = true;
+    forEachBit(str, [&](size_t bit) {
+        result = result && (_bits[bit / 64] & (1ULL << bit % 64)) != 0;
+    });
+    return result;
+}
@@ -0,0 +1,57 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef BloomFilter_h
+#define BloomFilter_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/// A set of strings which might answer "maybe" for strings never added, but
+/// never "no" for strings added, in a few bits per string.
+class BloomFilter {
+public:
+    // The size is chosen for a false positive rate well below 1% when not
+    // more than the given number of strings are added.
+    explicit BloomFilter(size_t expected_elements);
+
+    void add(std::string_view str);
+    [[nodiscard]] bool mightContain(std::string_view str) const;
+    [[nodiscard]] size_t bytes() const {
+        return _bits.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr size_t num_hashes = 4;
+    std::vector<uint64_t> _bits;
+    size_t _mask;  // number of bits - 1, a power of 2
+
+    template <typename F>
+    void forEachBit(std::string_view str, F f) const;
+};
+
+#endif  // BloomFilter_h
@@ -30,6 +30,8 @@
 #include "Object.h"
 #include "cmc.h"
 #else
+#include "MonitoringCore.h"
+#include "Store.h"
 #include "nagios.h"
 #endif
 
@@ -52,3 +54,17 @@ std::vector<std::string> ContactGroupsColumn::getValue(
 #endif
     return names;
 }
+
+bool ContactGroupsColumn::contains(Row row, const contact *auth_user,
+                                   const std::string &value,
+                                   std::chrono::seconds timezone_offset) const {
+#ifndef CMC
+    const auto &index = _mc->impl<Store>()->_group_membership._contact_groups;
+    if (auto p = columnData<contactgroupsmember *>(row)) {
+        if (auto member = index.find(p, value)) {
+            return *member != nullptr;
+        }
+    }
+#endif
+    return ListColumn::contains(row, auth_user, value, timezone_offset);
+}
@@ -31,19 +31,27 @@
 #include <vector>
 #include "ListColumn.h"
 #include "contact_fwd.h"
+class MonitoringCore;
 class Row;
 
 class ContactGroupsColumn : public ListColumn {
 public:
     ContactGroupsColumn(const std::string &name, const std::string &description,
                         int indirect_offset, int extra_offset,
-                        int extra_extra_offset, int offset)
+                        int extra_extra_offset, int offset, MonitoringCore *mc)
         : ListColumn(name, description, indirect_offset, extra_offset,
-                     extra_extra_offset, offset) {}
+                     extra_extra_offset, offset)
+        , _mc(mc) {}
 
     std::vector<std::string> getValue(
         Row row, const contact *auth_user,
         std::chrono::seconds timezone_offset) const override;
+
+    bool contains(Row row, const contact *auth_user, const std::string &value,
+                  std::chrono::seconds timezone_offset) const override;
+
+private:
+    MonitoringCore *const _mc;
 };
 
 #endif  // ContactGroupsColumn_h
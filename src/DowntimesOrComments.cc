@@ -23,7 +23,9 @@
 // Boston, MA 02110-1301 USA.
 
 #include "DowntimesOrComments.h"
+#include <algorithm>
 #include <iosfwd>
+#include <utility>
 #include "DowntimeOrComment.h"
 #include "Logger.h"
 
@@ -35,10 +37,10 @@ void DowntimesOrComments::registerDowntime(nebstruct_downtime_data *data) {
     switch (data->type) {
         case NEBTYPE_DOWNTIME_ADD:
         case NEBTYPE_DOWNTIME_LOAD:
-            _entries[id] = std::make_unique<Downtime>(data);
+            add(std::make_unique<Downtime>(data));
             break;
         case NEBTYPE_DOWNTIME_DELETE:
-            if (_entries.erase(id) == 0) {
+            if (!remove(id)) {
                 Informational(_logger)
                     << "Cannot delete non-existing downtime " << id;
             }
@@ -53,10 +55,10 @@ void DowntimesOrComments::registerComment(nebstruct_comment_data *data) {
     switch (data->type) {
         case NEBTYPE_COMMENT_ADD:
         case NEBTYPE_COMMENT_LOAD:
-            _entries[id] = std::make_unique<Comment>(data);
+            add(std::make_unique<Comment>(data));
             break;
         case NEBTYPE_COMMENT_DELETE:
-            if (_entries.erase(id) == 0) {
+            if (!remove(id)) {
                 Informational(_logger)
                     << "Cannot delete non-existing comment " << id;
             }
@@ -65,3 +67,47 @@ void DowntimesOrComments::registerComment(nebstruct_comment_data *data) {
             break;
     }
 }
+
+void DowntimesOrComments::add(std::unique_ptr<DowntimeOrComment> entry) {
+    unsigned long id = entry->_id;
+    remove(id);
+    _by_object[{entry->_host, entry->_service}][id] = entry.get();
+    _entries[id] = std::move(entry);
+}
+
+bool DowntimesOrComments::remove(unsigned long id) {
+    auto it = _entries.find(id);
+    if (it == _entries.end()) {
+        return false;
+    }
+    auto oit = _by_object.find({it->second->_host, it->second->_service});
+    if (oit != _by_object.end()) {
+        oit->second.erase(id);
+        if (oit->second.empty()) {
+            _by_object.erase(oit);
+        }
+    }
+    _entries.erase(it);
+    return true;
+}
+
+const DowntimesOrComments::by_id_t &DowntimesOrComments::forObject(
+    const host *hst, const service *svc) const {
+    static const by_id_t empty;
+    auto it = _by_object.find({hst, svc});
+    return it == _by_object.end() ? empty : it->second;
+}
+
+std::vector<const DowntimeOrComment *> DowntimesOrComments::forHost(
+    const host *hst) const {
+    std::vector<const DowntimeOrComment *> result;
+    for (auto it = _by_object.lower_bound({hst, nullptr});
+         it != _by_object.end() && it->first.first == hst; ++it) {
+        for (const auto &entry : it->second) {
+            result.push_back(entry.second);
+        }
+    }
+    std::sort(result.begin(), result.end(),
+              [](const auto *a, const auto *b) { return a->_id < b->_id; });
+    return result;
+}
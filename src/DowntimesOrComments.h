@@ -28,21 +28,40 @@
 #include "config.h"  // IWYU pragma: keep
 #include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 #include "nagios.h"
 class DowntimeOrComment;
 class Logger;
 
 class DowntimesOrComments {
 public:
+    using by_id_t = std::map<unsigned long, const DowntimeOrComment *>;
+
     DowntimesOrComments();
     void registerDowntime(nebstruct_downtime_data *data);
     void registerComment(nebstruct_comment_data *data);
     [[nodiscard]] auto begin() const { return _entries.cbegin(); }
     [[nodiscard]] auto end() const { return _entries.cend(); }
 
+    // The entries of a single host (svc == nullptr) or service, ordered by
+    // id. The result is a view into our index, nothing is copied.
+    [[nodiscard]] const by_id_t &forObject(const host *hst,
+                                           const service *svc) const;
+
+    // The entries of a host and all of its services, ordered by id.
+    [[nodiscard]] std::vector<const DowntimeOrComment *> forHost(
+        const host *hst) const;
+
 private:
+    using object_key_t = std::pair<const host *, const service *>;
+
     std::map<unsigned long, std::unique_ptr<DowntimeOrComment>> _entries;
+    std::map<object_key_t, by_id_t> _by_object;
     Logger *const _logger;
+
+    void add(std::unique_ptr<DowntimeOrComment> entry);
+    bool remove(unsigned long id);
 };
 
 #endif  // DowntimesOrComments_h
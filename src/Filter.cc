@@ -31,6 +31,11 @@ std::optional<std::string> Filter::stringValueRestrictionFor(
     return {};
 }
 
+std::optional<std::string> Filter::requiredSubstringFor(
+    const std::string& /* column_name */) const {
+    return {};
+}
+
 std::optional<int32_t> Filter::greatestLowerBoundFor(
     const std::string& /* column_name */,
     std::chrono::seconds /* timezone_offset */) const {
@@ -63,6 +63,10 @@ public:
     // values.
     [[nodiscard]] virtual std::optional<std::string> stringValueRestrictionFor(
         const std::string &column_name) const;
+    // A text which all accepted values of the column contain, ignoring the
+    // case of ASCII letters.
+    [[nodiscard]] virtual std::optional<std::string> requiredSubstringFor(
+        const std::string &column_name) const;
     [[nodiscard]] virtual std::optional<int32_t> greatestLowerBoundFor(
         const std::string &column_name,
         std::chrono::seconds timezone_offset) const;
@@ -0,0 +1,115 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "GroupMembership.h"
+#include "nagios.h"
+
+extern host *host_list;
+extern service *service_list;
+
+namespace {
+template <typename T>
+void addContacts(GroupMembership::Index &index, const T *object) {
+    index.addKey(object);
+    for (auto cm = object->contacts; cm != nullptr; cm = cm->next) {
+        index.add(object, cm->contact_ptr->name, cm->contact_ptr);
+    }
+    for (auto cgm = object->contact_groups; cgm != nullptr; cgm = cgm->next) {
+        for (auto cm = cgm->group_ptr->members; cm != nullptr; cm = cm->next) {
+            index.add(object, cm->contact_ptr->name, cm->contact_ptr);
+        }
+    }
+}
+
+template <typename T>
+void addContactGroups(GroupMembership::Index &index, const T *object) {
+    index.addKey(&object->contact_groups);
+    for (auto cgm = object->contact_groups; cgm != nullptr; cgm = cgm->next) {
+        index.add(&object->contact_groups, cgm->group_ptr->group_name,
+                  cgm->group_ptr);
+    }
+}
+}  // namespace
+
+void GroupMembership::Index::clear() {
+    _ids.clear();
+    _members.clear();
+    _bitsets.clear();
+}
+
+void GroupMembership::Index::addKey(const void *key) { _bitsets[key]; }
+
+void GroupMembership::Index::add(const void *key, const std::string &name,
+                                 const void *member) {
+    auto &bits = _bitsets[key];
+    auto it = _ids.emplace(name, _members.size()).first;
+    if (it->second == _members.size()) {
+        _members.push_back(member);
+    }
+    if (bits.size() <= it->second) {
+        bits.resize(it->second + 1);
+    }
+    bits[it->second] = true;
+}
+
+std::optional<const void *> GroupMembership::Index::find(
+    const void *key, const std::string &name) const {
+    auto bits = _bitsets.find(key);
+    if (bits == _bitsets.end()) {
+        return {};
+    }
+    auto it = _ids.find(name);
+    if (it == _ids.end() || it->second >= bits->second.size() ||
+        !bits->second[it->second]) {
+        return nullptr;
+    }
+    return _members[it->second];
+}
+
+void GroupMembership::rebuild() {
+    _host_groups.clear();
+    _service_groups.clear();
+    _contact_groups.clear();
+    _contacts.clear();
+    for (host *hst = host_list; hst != nullptr; hst = hst->next) {
+        _host_groups.addKey(&hst->hostgroups_ptr);
+        for (objectlist *ol = hst->hostgroups_ptr; ol != nullptr;
+             ol = ol->next) {
+            auto hg = static_cast<hostgroup *>(ol->object_ptr);
+            _host_groups.add(&hst->hostgroups_ptr, hg->group_name, hg);
+        }
+        addContactGroups(_contact_groups, hst);
+        addContacts(_contacts, hst);
+    }
+    for (service *svc = service_list; svc != nullptr; svc = svc->next) {
+        _service_groups.addKey(&svc->servicegroups_ptr);
+        for (objectlist *ol = svc->servicegroups_ptr; ol != nullptr;
+             ol = ol->next) {
+            auto sg = static_cast<servicegroup *>(ol->object_ptr);
+            _service_groups.add(&svc->servicegroups_ptr, sg->group_name, sg);
+        }
+        addContactGroups(_contact_groups, svc);
+        addContacts(_contacts, svc);
+    }
+}
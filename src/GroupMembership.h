@@ -0,0 +1,73 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef GroupMembership_h
+#define GroupMembership_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Host, service and contact group memberships and the contacts of hosts and
+/// services as bitsets over dense ids, so that list filters like "groups >=
+/// web" become a hash lookup plus a bit test instead of building and
+/// comparing a list of names for every row.
+///
+/// The indices are built from the Nagios thread before the query threads are
+/// started and are read-only afterwards, so no locking is needed.
+class GroupMembership {
+public:
+    class Index {
+    public:
+        void clear();
+        // Entities without any members have to be added, too, otherwise
+        // find() can't tell them from unknown ones.
+        void addKey(const void *key);
+        void add(const void *key, const std::string &name, const void *member);
+
+        // Returns the member called name of the entity key, nullptr if it is
+        // not a member, or nothing if key is unknown.
+        [[nodiscard]] std::optional<const void *> find(
+            const void *key, const std::string &name) const;
+
+    private:
+        std::unordered_map<std::string, size_t> _ids;
+        std::vector<const void *> _members;
+        std::unordered_map<const void *, std::vector<bool>> _bitsets;
+    };
+
+    void rebuild();
+
+    // Keyed by &host::hostgroups_ptr and &service::servicegroups_ptr.
+    Index _host_groups;
+    Index _service_groups;
+    // Keyed by &host::contact_groups and &service::contact_groups.
+    Index _contact_groups;
+    // Keyed by host and service, contacts either direct or via a group.
+    Index _contacts;
+};
+
+#endif  // GroupMembership_h
@@ -31,6 +31,8 @@
 #include "cmc.h"
 #else
 #include <unordered_set>
+#include "MonitoringCore.h"
+#include "Store.h"
 #include "nagios.h"
 #endif
 
@@ -58,3 +60,17 @@ std::vector<std::string> HostContactsColumn::getValue(
     return std::vector<std::string>(names.begin(), names.end());
 #endif
 }
+
+bool HostContactsColumn::contains(Row row, const contact* auth_user,
+                                  const std::string& value,
+                                  std::chrono::seconds timezone_offset) const {
+#ifndef CMC
+    const auto& index = _mc->impl<Store>()->_group_membership._contacts;
+    if (auto p = columnData<host>(row)) {
+        if (auto member = index.find(p, value)) {
+            return *member != nullptr;
+        }
+    }
+#endif
+    return ListColumn::contains(row, auth_user, value, timezone_offset);
+}
@@ -30,6 +30,7 @@
 #include "ObjectGroup.h"
 #include "cmc.h"
 #else
+#include "Store.h"
 #include "auth.h"
 #include "nagios.h"
 #endif
@@ -58,3 +59,19 @@ std::vector<std::string> HostGroupsColumn::getValue(
 #endif
     return group_names;
 }
+
+bool HostGroupsColumn::contains(Row row, const contact *auth_user,
+                                const std::string &value,
+                                std::chrono::seconds timezone_offset) const {
+#ifndef CMC
+    const auto &index = _mc->impl<Store>()->_group_membership._host_groups;
+    if (auto p = columnData<objectlist *>(row)) {
+        if (auto member = index.find(p, value)) {
+            return *member != nullptr &&
+                   is_authorized_for_host_group(
+                       _mc, static_cast<const hostgroup *>(*member), auth_user);
+        }
+    }
+#endif
+    return ListColumn::contains(row, auth_user, value, timezone_offset);
+}
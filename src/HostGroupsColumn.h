@@ -47,6 +47,9 @@ public:
         Row row, const contact *auth_user,
         std::chrono::seconds timezone_offset) const override;
 
+    bool contains(Row row, const contact *auth_user, const std::string &value,
+                  std::chrono::seconds timezone_offset) const override;
+
 private:
     MonitoringCore *const _mc;
 };
@@ -31,6 +31,8 @@
 #include "Host.h"
 #include "State.h"
 #else
+#include "StateAggregates.h"
+#include "Store.h"
 #include "auth.h"
 #endif
 
@@ -46,6 +48,11 @@ int32_t HostListStateColumn::getValue(Row row, const contact *auth_user) const {
     }
 #else
     if (auto p = columnData<hostsmember *>(row)) {
+        StateAggregates::Hosts hosts;
+        if (auth_user == nullptr &&
+            _mc->impl<Store>()->_state_aggregates.hostsFor(p, hosts)) {
+            return getValueFromAggregate(hosts);
+        }
         for (hostsmember *mem = *p; mem != nullptr; mem = mem->next) {
             host *hst = mem->host_ptr;
             if (auth_user == nullptr ||
@@ -58,6 +65,56 @@ int32_t HostListStateColumn::getValue(Row row, const contact *auth_user) const {
     return result;
 }
 
+#ifndef CMC
+int32_t HostListStateColumn::getValueFromAggregate(
+    const StateAggregates::Hosts &hosts) const {
+    switch (_logictype) {
+        case Type::num_svc_pending:
+        case Type::num_svc_ok:
+        case Type::num_svc_warn:
+        case Type::num_svc_crit:
+        case Type::num_svc_unknown:
+        case Type::num_svc:
+        case Type::worst_svc_state:
+            return ServiceListStateColumn::getValueFromAggregate(
+                static_cast<ServiceListStateColumn::Type>(_logictype),
+                hosts._services);
+
+        case Type::num_hst_up:
+        case Type::num_hst_down:
+        case Type::num_hst_unreach:
+            return hosts._num_state[static_cast<int>(_logictype) -
+                                    static_cast<int>(Type::num_hst_up)];
+
+        case Type::num_hst_pending:
+            return hosts._num_pending;
+
+        case Type::num_hst:
+            return hosts._num;
+
+        case Type::worst_hst_state: {
+            int32_t result = 0;
+            for (int32_t state = 0; state < 3; ++state) {
+                if (hosts._all_state[state] > 0 &&
+                    worse(static_cast<HostState>(state),
+                          static_cast<HostState>(result))) {
+                    result = state;
+                }
+            }
+            return result;
+        }
+        case Type::num_svc_hard_ok:
+        case Type::num_svc_hard_warn:
+        case Type::num_svc_hard_crit:
+        case Type::num_svc_hard_unknown:
+        case Type::worst_svc_hard_state:
+            // Not handled by update() either, see the TODO there.
+            break;
+    }
+    return 0;
+}
+#endif
+
 void HostListStateColumn::update(host *hst, const contact *auth_user,
                                  int32_t &result) const {
 #ifdef CMC
@@ -36,6 +36,7 @@ class Row;
 #ifdef CMC
 #include "cmc.h"
 #else
+#include "StateAggregates.h"
 #include "nagios.h"
 #endif
 
@@ -87,6 +88,10 @@ private:
     const Type _logictype;
 
     void update(host *hst, const contact *auth_user, int32_t &result) const;
+#ifndef CMC
+    [[nodiscard]] int32_t getValueFromAggregate(
+        const StateAggregates::Hosts &hosts) const;
+#endif
 };
 
 #endif  // HostListStateColumn_h
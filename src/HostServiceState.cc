@@ -23,6 +23,7 @@
 // Boston, MA 02110-1301 USA.
 
 #include "HostServiceState.h"
+#include <utility>
 
 HostServiceState::HostServiceState()
     : _is_host(false)
@@ -55,6 +56,13 @@ HostServiceState::HostServiceState()
     , _host(nullptr)
     , _service(nullptr) {}
 
+HostServiceState *HostServiceStateArena::allocate(HostServiceState state) {
+    if (_blocks.empty() || _blocks.back().size() == block_size) {
+        _blocks.emplace_back().reserve(block_size);
+    }
+    return &_blocks.back().emplace_back(std::move(state));
+}
+
 #ifdef CMC
 void HostServiceState::computePerStateDurations() {
     _duration_state_UNMONITORED = 0;
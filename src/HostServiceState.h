@@ -26,8 +26,10 @@
 #define HostServiceState_h
 
 #include "config.h"  // IWYU pragma: keep
+#include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <map>
 #include <string>
 #include <vector>
 class HostServiceState;
@@ -104,4 +106,34 @@ public:
 #endif
 };
 
+/// Storage for many states, allocated in blocks which are released together
+/// instead of one by one. The states never move.
+class HostServiceStateArena {
+public:
+    HostServiceStateArena() = default;
+    HostServiceStateArena(const HostServiceStateArena &) = delete;
+    HostServiceStateArena &operator=(const HostServiceStateArena &) = delete;
+    HostServiceStateArena(HostServiceStateArena &&) = default;
+    HostServiceStateArena &operator=(HostServiceStateArena &&) = default;
+
+    HostServiceState *allocate(HostServiceState state = HostServiceState());
+    // Releases the state allocated last, if it turned out to be unneeded.
+    void releaseLast() { _blocks.back().pop_back(); }
+    void clear() { _blocks.clear(); }
+
+private:
+    static constexpr size_t block_size = 256;
+    std::vector<std::vector<HostServiceState>> _blocks;
+};
+
+/// What the replay of the log in TableStateHistory knows about all hosts and
+/// services at some point of the log, so the replay can be continued later.
+struct HostServiceStates {
+    HostServiceStateArena _arena;
+    std::map<HostServiceKey, HostServiceState *> _state_info;
+    // Notification periods information, name: active(1)/inactive(0)
+    std::map<std::string, int> _notification_periods;
+    bool _in_nagios_initial_states = false;
+};
+
 #endif  // HostServiceState_h
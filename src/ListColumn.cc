@@ -23,7 +23,9 @@
 // Boston, MA 02110-1301 USA.
 
 #include "ListColumn.h"
+#include <algorithm>
 #include <stdexcept>
+#include <vector>
 #include "Filter.h"
 #include "ListFilter.h"
 #include "Renderer.h"
@@ -37,6 +39,13 @@ void ListColumn::output(Row row, RowRenderer &r, const contact *auth_user,
     }
 }
 
+bool ListColumn::contains(Row row, const contact *auth_user,
+                          const std::string &value,
+                          std::chrono::seconds timezone_offset) const {
+    auto val = getValue(row, auth_user, timezone_offset);
+    return std::find(val.begin(), val.end(), value) != val.end();
+}
+
 std::unique_ptr<Filter> ListColumn::createFilter(
     Filter::Kind kind, RelationalOperator relOp,
     const std::string &value) const {
@@ -63,6 +63,12 @@ public:
     virtual std::vector<std::string> getValue(
         Row row, const contact *auth_user,
         std::chrono::seconds timezone_offset) const = 0;
+
+    // Is value an element of getValue()? Columns can override this if they
+    // can answer it without building the whole list.
+    virtual bool contains(Row row, const contact *auth_user,
+                          const std::string &value,
+                          std::chrono::seconds timezone_offset) const;
 };
 
 #endif  // ListColumn_h
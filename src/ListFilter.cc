@@ -92,11 +92,13 @@ bool ListFilter::accepts(Row row, const contact *auth_user,
                 row, auth_user, timezone_offset,
                 [&](const std::string &elem) { return _regExp->search(elem); });
         case RelationalOperator::greater_or_equal:
+            return _column.contains(row, auth_user, value(), timezone_offset);
         case RelationalOperator::less_or_equal:
             return any(
                 row, auth_user, timezone_offset,
                 [&](const std::string &elem) { return _regExp->match(elem); });
         case RelationalOperator::less:
+            return !_column.contains(row, auth_user, value(), timezone_offset);
         case RelationalOperator::greater:
             return !any(
                 row, auth_user, timezone_offset,
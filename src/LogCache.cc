@@ -23,31 +23,50 @@
 // Boston, MA 02110-1301 USA.
 
 #include "LogCache.h"
+#include <algorithm>
 #include <sstream>
 #include <string>
+#include <system_error>
 #include <utility>
+#include <vector>
 #include "FileSystem.h"
 #include "LogEntry.h"  // IWYU pragma: keep
 #include "Logfile.h"
+#include "LogfileIndex.h"
+#include "LogfileSnapshot.h"
 #include "Logger.h"
 #include "MonitoringCore.h"
+#include "global_counters.h"
 
 namespace {
 // Check memory every N'th new message
 constexpr unsigned long check_mem_cycle = 1000;
+
+// for estimating the number of entries in a logfile from its size
+constexpr size_t typical_line_length = 100;
 }  // namespace
 
 int num_cached_log_messages = 0;
+double num_cached_log_bytes = 0;
 
-LogCache::LogCache(MonitoringCore *mc, unsigned long max_cached_messages)
+LogCache::LogCache(MonitoringCore *mc, unsigned long max_cached_messages,
+                   unsigned long max_cached_bytes)
     : _mc(mc)
     , _max_cached_messages(max_cached_messages)
-    , _num_at_last_check(0) {
+    , _max_cached_bytes(max_cached_bytes)
+    , _num_at_last_check(0)
+    , _prefetching_bytes(0)
+    , _derived_bytes(0)
+    , _logfiles(std::make_shared<logfiles_t>())
+    , _ticks(0)
+    , _tail(mc->historyFilePath())
+    , _prefetcher(prefetch_depth) {
     update();
 }
 
 #ifdef CMC
 void LogCache::setMaxCachedMessages(unsigned long m) {
+    std::lock_guard<std::mutex> lg(_lock);
     if (m != _max_cached_messages) {
         Notice(logger())
             << "changing maximum number of messages for log file cache to "
@@ -55,42 +74,113 @@ void LogCache::setMaxCachedMessages(unsigned long m) {
         _max_cached_messages = m;
     }
 }
+
+void LogCache::setMaxCachedBytes(unsigned long b) {
+    std::lock_guard<std::mutex> lg(_lock);
+    if (b != _max_cached_bytes) {
+        Notice(logger())
+            << "changing maximum number of bytes for log file cache to " << b;
+        _max_cached_bytes = b;
+    }
+}
 #endif
 
+void LogCache::logLineWritten(time_t time, const char *message) {
+    _tail.add(time, message);
+}
+
+std::shared_ptr<const logfiles_t> LogCache::logfiles() {
+    std::lock_guard<std::mutex> lg(_lock);
+    update();
+    return _logfiles;
+}
+
 void LogCache::update() {
-    if (!_logfiles.empty() &&
+    if (!_logfiles->empty() &&
         _mc->last_logfile_rotation() <= _last_index_update) {
         return;
     }
 
     Informational(logger()) << "updating log file index";
 
-    _logfiles.clear();
-    num_cached_log_messages = 0;
+    // Running queries keep the old index and its logfiles alive. The archive
+    // files we already know are kept with their cached messages, only new
+    // files are opened.
+    std::shared_ptr<Logfile> previous;
+    std::map<fs::path, std::shared_ptr<Logfile>> archived;
+    for (const auto &entry : *_logfiles) {
+        if (entry.second->isWatched()) {
+            previous = entry.second;
+        } else {
+            archived.emplace(entry.second->path(), entry.second);
+        }
+    }
+    auto logfiles = std::make_shared<logfiles_t>();
+    _num_at_last_check = 0;
 
     _last_index_update = std::chrono::system_clock::now();
     // We need to find all relevant logfiles. This includes directory, the
     // current nagios.log and all files in the archive.
-    addToIndex(
-        std::make_unique<Logfile>(_mc, this, _mc->historyFilePath(), true));
+    auto current =
+        std::make_shared<Logfile>(_mc, this, _mc->historyFilePath(), true);
+    if (previous && current->since() == previous->since()) {
+        current = previous;  // not rotated at all
+        previous.reset();
+    }
+    addToIndex(*logfiles, current);
 
     fs::path dirpath = _mc->logArchivePath();
+    // The sidecars with the archive they belong to
+    std::vector<std::pair<fs::path, fs::path>> sidecars;
     try {
         for (const auto &entry : fs::directory_iterator(dirpath)) {
-            addToIndex(
-                std::make_unique<Logfile>(_mc, this, entry.path(), false));
+            if (LogfileIndex::isIndexFile(entry.path())) {
+                sidecars.emplace_back(
+                    entry.path(), LogfileIndex::logfileOf(entry.path()));
+                continue;
+            }
+            if (LogfileSnapshot::isSnapshotFile(entry.path())) {
+                sidecars.emplace_back(
+                    entry.path(), LogfileSnapshot::logfileOf(entry.path()));
+                continue;
+            }
+            auto it = archived.find(entry.path());
+            if (it != archived.end()) {
+                addToIndex(*logfiles, it->second);
+                continue;
+            }
+            auto logfile =
+                std::make_shared<Logfile>(_mc, this, entry.path(), false);
+            if (previous && logfile->since() == previous->since()) {
+                // the previous current logfile, rotated into the archive
+                logfile->takeOver(*previous);
+                previous.reset();
+                _prefetcher.submit([logfile] { logfile->writeSidecars(); });
+            }
+            addToIndex(*logfiles, logfile);
         }
     } catch (const fs::filesystem_error &e) {
         Warning(logger()) << "updating log file index: " << e.what();
     }
+    // Housekeeping removes old archives, but it doesn't know our sidecars.
+    for (const auto &[sidecar, archive] : sidecars) {
+        std::error_code ec;
+        if (!fs::exists(archive, ec) && !ec && fs::remove(sidecar, ec)) {
+            Debug(logger()) << "removed " << sidecar << " of vanished "
+                            << archive;
+        }
+    }
 
-    if (_logfiles.empty()) {
+    if (logfiles->empty()) {
         Notice(logger()) << "no log file found, not even "
                          << _mc->historyFilePath();
     }
+    _logfiles = std::move(logfiles);
+    updateStatistics();
 }
 
-void LogCache::addToIndex(std::unique_ptr<Logfile> logfile) {
+void LogCache::addToIndex(logfiles_t &logfiles,
+                          std::shared_ptr<Logfile> logfile) {
     time_t since = logfile->since();
     if (since == 0) {
         return;
@@ -98,109 +188,177 @@ void LogCache::addToIndex(std::unique_ptr<Logfile> logfile) {
     // make sure that no entry with that 'since' is existing yet.  Under normal
     // circumstances this never happens, but the user might have copied files
     // around.
-    if (_logfiles.find(since) != _logfiles.end()) {
+    if (logfiles.find(since) != logfiles.end()) {
         Warning(logger()) << "ignoring duplicate log file " << logfile->path();
         return;
     }
 
-    _logfiles.emplace(since, std::move(logfile));
+    logfiles.emplace(since, std::move(logfile));
 }
 
-/* This method is called each time a log message is loaded
-   into memory. If the number of messages loaded in memory
-   is to large, memory will be freed by flushing logfiles
-   and message not needed by the current query.
-
-   The parameters to this method reflect the current query,
-   not the messages that just has been loaded.
- */
-void LogCache::logLineHasBeenAdded(Logfile *logfile, unsigned logclasses) {
-    if (static_cast<unsigned long>(++num_cached_log_messages) <=
-        _max_cached_messages) {
-        return;  // current message count still allowed, everything ok
-    }
-
-    /* Memory checking an freeing consumes CPU ressources. We save
-       ressources, by avoiding to make the memory check each time
-       a new message is loaded when being in a sitation where no
-       memory can be freed. We do this by suppressing the check when
-       the number of messages loaded into memory has not grown
-       by at least check_mem_cycle messages */
+// Called each time log messages have been loaded into memory. If the cache
+// is over its limits, memory is freed by dropping the older halves of
+// logfiles, then whole logfiles, and then the messages not needed by the
+// current query. The parameters reflect the current query,
+// not the messages that have just been loaded.
+//
+// Logfiles which are currently being loaded by another query are left alone,
+// and queries keep the messages they are working on alive, so nothing is
+// actually freed under their feet.
+void LogCache::logLinesHaveBeenAdded(const Logfile *logfile,
+                                     size_t /* num_lines */,
+                                     unsigned logclasses) {
+    std::lock_guard<std::mutex> lg(_lock);
+    if (updateStatistics()) {
+        return;  // still within our limits, everything ok
+    }
+
+    // Memory checking an freeing consumes CPU ressources. We save ressources
+    // by avoiding to make the memory check each time a new message is loaded
+    // when being in a sitation where no memory can be freed. We do this by
+    // suppressing the check when the number of messages loaded into memory
+    // has not grown by at least check_mem_cycle messages.
     if (static_cast<unsigned long>(num_cached_log_messages) <
         _num_at_last_check + check_mem_cycle) {
         return;  // Do not check this time
     }
 
-    // [1] Begin by deleting old logfiles
-    // Begin deleting with the oldest logfile available
-    logfiles_t::iterator it;
-    for (it = _logfiles.begin(); it != _logfiles.end(); ++it) {
-        if (it->second.get() == logfile) {
-            // Do not touch the logfile the Query is currently accessing
-            break;
+    auto freed_enough = [&](size_t freed) {
+        if (freed == 0) {
+            return false;
         }
-        if (it->second->size() > 0) {
-            num_cached_log_messages -= it->second->size();
-            it->second->flush();  // drop all messages of that file
-            if (static_cast<unsigned long>(num_cached_log_messages) <=
-                _max_cached_messages) {
-                // remember the number of log messages in cache when
-                // the last memory-release was done. No further
-                // release-check shall be done until that number changes.
-                _num_at_last_check = num_cached_log_messages;
-                return;
-            }
+        counterIncrement(Counter::log_cache_evictions);
+        if (updateStatistics()) {
+            // remember the number of log messages in cache when the last
+            // memory-release was done. No further release-check shall be done
+            // until that number changes.
+            _num_at_last_check = num_cached_log_messages;
+            return true;
         }
-    }
-    // The end of this loop must be reached by 'break'. At least one logfile
-    // must be the current logfile. So now 'it' points to the current logfile.
-    // We save that pointer for later.
-    auto queryit = it;
+        return false;
+    };
 
-    // [2] Delete message classes irrelevent to current query
-    // Starting from the current logfile (wo broke out of the
-    // previous loop just when 'it' pointed to that)
-    for (; it != _logfiles.end(); ++it) {
-        if (it->second->size() > 0 &&
-            (it->second->classesRead() & ~logclasses) != 0) {
-            Debug(logger()) << "freeing classes " << ~logclasses << " of file "
-                            << it->second->path();
-            // flush only messages not needed for current query
-            long freed = it->second->freeMessages(~logclasses);
-            num_cached_log_messages -= freed;
-            if (static_cast<unsigned long>(num_cached_log_messages) <=
-                _max_cached_messages) {
-                _num_at_last_check = num_cached_log_messages;
-                return;
-            }
+    // The logfile the query is currently accessing. It might be missing when
+    // the index has been updated in the meantime.
+    Logfile *current = nullptr;
+    std::vector<Logfile *> candidates;
+    for (const auto &entry : *_logfiles) {
+        Logfile *lf = entry.second.get();
+        if (lf == logfile) {
+            current = lf;
+        } else if (!lf->isWatched() && lf->numCachedMessages() != 0) {
+            candidates.push_back(lf);
         }
     }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Logfile *lf1, const Logfile *lf2) {
+                  return std::make_pair(lf1->hits() != 0, lf1->lastUse()) <
+                         std::make_pair(lf2->hits() != 0, lf2->lastUse());
+              });
 
-    // [3] Flush newest logfiles
-    // If there are still too many messages loaded, continue
-    // flushing logfiles from the oldest to the newest starting
-    // at the file just after (i.e. newer than) the current logfile
-    for (it = ++queryit; it != _logfiles.end(); ++it) {
-        if (it->second->size() > 0) {
-            Debug(logger()) << "flush newer log, " << it->second->size()
-                            << " number of entries";
-            num_cached_log_messages -= it->second->size();
-            it->second->flush();
-            if (static_cast<unsigned long>(num_cached_log_messages) <=
-                _max_cached_messages) {
-                _num_at_last_check = num_cached_log_messages;
-                return;
-            }
+    // [1] Free the other logfiles, the least valuable first. Queries mostly
+    // look at the recent entries, so a logfile loses its older half before
+    // the rest.
+    for (auto *lf : candidates) {
+        if (freed_enough(lf->freeOlderHalf()) || freed_enough(lf->flush())) {
+            return;
         }
     }
-    _num_at_last_check = num_cached_log_messages;
-    // If we reach this point, no more logfiles can be unloaded,
-    // despite the fact that there are still too many messages
-    // loaded.
 
+    // [2] Delete message classes irrelevent to current query
+    if (current != nullptr && !current->isWatched() &&
+        freed_enough(current->freeMessages(~logclasses))) {
+        return;
+    }
+
+    _num_at_last_check = num_cached_log_messages;
+    // If we reach this point, no more logfiles can be unloaded, despite the
+    // fact that there are still too many messages loaded.
     Debug(logger()) << "cannot unload more messages, still "
                     << num_cached_log_messages << " loaded (max is "
-                    << _max_cached_messages << ")";
+                    << _max_cached_messages << "), "
+                    << static_cast<size_t>(num_cached_log_bytes)
+                    << " bytes (max is " << _max_cached_bytes << ")";
+}
+
+void LogCache::setDerivedBytes(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        if (bytes > _derived_bytes) {
+            _num_at_last_check = 0;  // the messages alone don't show growth
+        }
+        _derived_bytes = bytes;
+    }
+    logLinesHaveBeenAdded(nullptr, 0, 0);
+}
+
+// The memory needed is estimated from the size of the file, which is a bit
+// pessimistic when only some classes are needed.
+void LogCache::prefetch(const std::shared_ptr<Logfile> &logfile,
+                        unsigned logclasses, time_t since,
+                        std::shared_ptr<const std::atomic<bool>> cancelled) {
+    std::error_code ec;
+    auto size = fs::file_size(logfile->path(), ec);
+    if (ec) {
+        return;
+    }
+    size_t needed = size + size / typical_line_length * sizeof(LogEntry);
+    size_t bytes = needed > logfile->numCachedBytes()
+                       ? needed - logfile->numCachedBytes()
+                       : 0;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        updateStatistics();
+        if (static_cast<size_t>(num_cached_log_bytes) + _prefetching_bytes +
+                bytes >
+            _max_cached_bytes) {
+            return;
+        }
+        _prefetching_bytes += bytes;
+    }
+    _prefetcher.submit([this, logfile, logclasses, since, cancelled, bytes] {
+        if (!*cancelled) {
+            logfile->prefetch(logclasses, since);
+        }
+        std::lock_guard<std::mutex> lg(_lock);
+        _prefetching_bytes -= bytes;
+    });
+}
+
+// Sums up the usage of all logfiles and of the derived data, returns true if
+// we are within the limits.
+bool LogCache::updateStatistics() {
+    size_t messages = 0;
+    size_t bytes = _derived_bytes;
+    for (const auto &entry : *_logfiles) {
+        messages += entry.second->numCachedMessages();
+        bytes += entry.second->numCachedBytes();
+    }
+    num_cached_log_messages = static_cast<int>(messages);
+    num_cached_log_bytes = static_cast<double>(bytes);
+    return messages <= _max_cached_messages && bytes <= _max_cached_bytes;
+}
+
+std::vector<std::string> LogCache::fileStatistics() {
+    std::lock_guard<std::mutex> lg(_lock);
+    std::vector<std::string> result;
+    for (const auto &entry : *_logfiles) {
+        const Logfile &lf = *entry.second;
+        std::ostringstream os;
+        os << lf.path().filename().string() << ";" << lf.numCachedMessages()
+           << ";" << lf.numCachedBytes() << ";" << lf.hits() << ";"
+           << lf.misses();
+        result.push_back(os.str());
+    }
+    return result;
+}
+
+const Command *LogCache::internCommand(const Command &command) {
+    std::lock_guard<std::mutex> lg(_commands_lock);
+    return &_commands
+                .emplace(std::make_pair(command._name, command._command_line),
+                         command)
+                .first->second;
 }
 
 Logger *LogCache::logger() const { return _mc->loggerLivestatus(); }
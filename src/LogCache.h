@@ -26,38 +26,115 @@
 #define LogCache_h
 
 #include "config.h"  // IWYU pragma: keep
+#include <atomic>
 #include <chrono>
+#include <cstddef>
 #include <ctime>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "LogPrefetcher.h"
+#include "LogTail.h"
+#include "MonitoringCore.h"
 class Logfile;
 class Logger;
-class MonitoringCore;
 
-using logfiles_t = std::map<time_t, std::unique_ptr<Logfile>>;
+using logfiles_t = std::map<time_t, std::shared_ptr<Logfile>>;
 
+/// The index of all logfiles plus the accounting of their cached messages.
+/// Queries work on a snapshot of the index and of the entries of each
+/// logfile, so they can run in parallel: Neither an index update after a log
+/// rotation nor the eviction of cached messages frees anything a running
+/// query still uses.
+///
+/// The cache is limited by a number of messages and a number of bytes. When
+/// it is full, whole logfiles are evicted in LRU order, where logfiles which
+/// have been used only once (e.g. by an ad-hoc query over a long time range)
+/// go before the ones used repeatedly (e.g. by dashboards). The current
+/// logfile is never evicted. Data derived from the log elsewhere, like the
+/// StateHistoryCache, is charged against the limit of bytes, too.
+///
+/// Queries scanning several logfiles have the older ones loaded in the
+/// background while they are busy with the newer ones, but only as far as the
+/// cache has room for them.
 class LogCache {
 public:
-    std::mutex _lock;
+    // How many logfiles a query loads ahead, and in parallel on a cold cache.
+    static constexpr size_t prefetch_depth = 4;
 
-    LogCache(MonitoringCore *mc, unsigned long max_cached_messages);
+    LogCache(MonitoringCore *mc, unsigned long max_cached_messages,
+             unsigned long max_cached_bytes);
 #ifdef CMC
     void setMaxCachedMessages(unsigned long m);
+    void setMaxCachedBytes(unsigned long b);
 #endif
-    void logLineHasBeenAdded(Logfile *logfile, unsigned logclasses);
-    void update();
-    auto begin() { return _logfiles.begin(); }
-    auto end() { return _logfiles.end(); }
+
+    // Updates the index if needed and returns a snapshot of it.
+    std::shared_ptr<const logfiles_t> logfiles();
+
+    // Called by a Logfile after it has loaded new messages for a query which
+    // needs the given classes, possibly evicting other messages.
+    void logLinesHaveBeenAdded(const Logfile *logfile, size_t num_lines,
+                               unsigned logclasses);
+
+    // Sets the size of the data derived from the log, possibly evicting
+    // cached messages to make room for it.
+    void setDerivedBytes(size_t bytes);
+
+    // Loads the given classes of a logfile on a background thread, unless
+    // they don't fit into the cache. Nothing happens if the query has been
+    // cancelled before a thread got to it.
+    void prefetch(const std::shared_ptr<Logfile> &logfile, unsigned logclasses,
+                  time_t since,
+                  std::shared_ptr<const std::atomic<bool>> cancelled);
+
+    // The commands referenced by cached messages. Each distinct command is
+    // stored only once and stays valid as long as the cache.
+    const Command *internCommand(const Command &command);
+
+    // Called by the core after it has written a line to the current logfile.
+    // Queries take new lines from here instead of reading the file.
+    void logLineWritten(time_t time, const char *message);
+    [[nodiscard]] const LogTail &tail() const { return _tail; }
+
+    // A clock for the LRU eviction, ticking on each use of a logfile.
+    unsigned long tick() { return ++_ticks; }
+
+    // One line per logfile: name;messages;bytes;hits;misses
+    std::vector<std::string> fileStatistics();
 
 private:
     MonitoringCore *const _mc;
+    // The mutex protects all fields below, num_cached_log_messages and
+    // num_cached_log_bytes. It is never held while loading a logfile.
+    std::mutex _lock;
     unsigned long _max_cached_messages;
+    unsigned long _max_cached_bytes;
     unsigned long _num_at_last_check;
-    logfiles_t _logfiles;
+    size_t _prefetching_bytes;  // estimated size of the queued prefetches
+    size_t _derived_bytes;
+    std::shared_ptr<const logfiles_t> _logfiles;
     std::chrono::system_clock::time_point _last_index_update;
 
-    void addToIndex(std::unique_ptr<Logfile> logfile);
+    // Commands are interned while loading, so they have a mutex of their own.
+    std::mutex _commands_lock;
+    std::map<std::pair<std::string, std::string>, Command> _commands;
+
+    std::atomic<unsigned long> _ticks;
+
+    // Written by the core, read without any lock, see LogTail. It knows the
+    // path of the current logfile, so we don't build it for each line.
+    LogTail _tail;
+
+    // Last, so its threads are gone before anything they use.
+    LogPrefetcher _prefetcher;
+
+    void update();
+    bool updateStatistics();
+    void addToIndex(logfiles_t &logfiles, std::shared_ptr<Logfile> logfile);
     [[nodiscard]] Logger *logger() const;
 };
 
@@ -23,54 +23,234 @@
 // Boston, MA 02110-1301 USA.
 
 #include "LogEntry.h"
-#include <cstdlib>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
 #include <utility>
+#include "LogCache.h"
 #include "MonitoringCore.h"
 
 // 0123456789012345678901234567890
 // [1234567890] FOO BAR: blah blah
 static constexpr size_t timestamp_prefix_length = 13;
 
+namespace {
+// Like atoi(), but the field is not necessarily NUL-terminated.
+int toInt(std::string_view str) {
+    size_t pos = str.find_first_not_of(' ');
+    int value = 0;
+    if (pos != std::string_view::npos) {
+        std::from_chars(str.data() + pos, str.data() + str.size(), value);
+    }
+    return value;
+}
+
+// Queries share the entries, so parseFields() has to be serialized, but the
+// entries are too many for a mutex of their own.
+std::array<std::mutex, 64> fields_mutexes;
+
+std::mutex &fieldsMutexFor(const LogEntry *entry) {
+    return fields_mutexes[(reinterpret_cast<uintptr_t>(entry) /
+                           sizeof(LogEntry)) %
+                          fields_mutexes.size()];
+}
+}  // namespace
+
 // TODO(sp) Fix classifyLogMessage() below to always set all fields and remove
 // this set-me-to-zero-to-be-sure-block.
-LogEntry::LogEntry(MonitoringCore *mc, size_t lineno, std::string line)
+LogEntry::LogEntry(size_t lineno, std::string_view line)
     : _lineno(static_cast<int32_t>(lineno))
-    , _complete(std::move(line))
     , _state(0)
     , _attempt(0)
     , _host(nullptr)
     , _service(nullptr)
-    , _contact(nullptr) {
-    // pointer to options (everything after ':')
-    size_t pos = _complete.find(':');
-    if (pos != std::string::npos) {
-        pos = _complete.find_first_not_of(' ', pos + 1);
+    , _contact(nullptr)
+    , _command(nullptr)
+    , _line(line.data())
+    , _line_length(static_cast<uint32_t>(line.size()))
+    , _def(nullptr)
+    , _host_name{0, 0}
+    , _svc_desc{0, 0}
+    , _command_name{0, 0}
+    , _contact_name{0, 0}
+    , _state_type{0, 0}
+    , _check_output{0, 0}
+    , _comment{0, 0}
+    , _fields_parsed(false) {
+    // offset of options (everything after ':')
+    size_t pos = line.find(':');
+    if (pos != std::string_view::npos) {
+        pos = line.find_first_not_of(' ', pos + 1);
     }
-    if (pos == std::string::npos) {
-        pos = _complete.size();
+    if (pos == std::string_view::npos) {
+        pos = line.size();
     }
-    _options = &_complete[pos];
+    _options = static_cast<uint32_t>(pos);
 
     try {
-        if (_complete.size() < timestamp_prefix_length || _complete[0] != '[' ||
-            _complete[11] != ']' || _complete[12] != ' ') {
+        if (line.size() < timestamp_prefix_length || line[0] != '[' ||
+            line[11] != ']' || line[12] != ' ') {
             throw std::invalid_argument("timestamp delimiter");
         }
-        _time = std::stoi(_complete.substr(1, 10));
+        _time = std::stoi(std::string(line.substr(1, 10)));
     } catch (const std::logic_error &e) {
+        _time = 0;
         _logclass = Class::invalid;
         _type = LogEntryType::none;
         return;  // ignore invalid lines silently
     }
 
     classifyLogMessage();
-    applyWorkarounds();
-    updateReferences(mc);
 }
 
-bool LogEntry::assign(Param par, const std::string &field) {
+LogEntry::LogEntry(size_t lineno, const char *line, const Summary &summary)
+    : _lineno(static_cast<int32_t>(lineno))
+    , _time(summary._time)
+    , _logclass(summary._logclass == invalid_class
+                    ? Class::invalid
+                    : static_cast<Class>(summary._logclass))
+    , _type(static_cast<LogEntryType>(summary._type))
+    , _state(0)
+    , _attempt(0)
+    , _host(nullptr)
+    , _service(nullptr)
+    , _contact(nullptr)
+    , _command(nullptr)
+    , _line(line)
+    , _line_length(summary._length)
+    , _options(summary._options)
+    , _def(summary._def < 0 ? nullptr : &log_definitions[summary._def])
+    , _host_name{0, 0}
+    , _svc_desc{0, 0}
+    , _command_name{0, 0}
+    , _contact_name{0, 0}
+    , _state_type{0, 0}
+    , _check_output{0, 0}
+    , _comment{0, 0}
+    , _fields_parsed(false) {}
+
+LogEntry::Summary LogEntry::summary() const {
+    return {static_cast<uint32_t>(_time),
+            _line_length,
+            _options,
+            static_cast<int16_t>(_def == nullptr ? -1
+                                                 : _def - &log_definitions[0]),
+            _logclass == Class::invalid ? invalid_class
+                                        : static_cast<uint8_t>(_logclass),
+            static_cast<uint8_t>(_type)};
+}
+
+// static
+bool LogEntry::isPlausible(const Summary &summary) {
+    if ((summary._logclass != invalid_class &&
+         summary._logclass > static_cast<uint8_t>(Class::alert_handlers)) ||
+        summary._type >
+            static_cast<uint8_t>(LogEntryType::acknowledge_alert_service) ||
+        summary._options > summary._length) {
+        return false;
+    }
+    if (summary._def < 0) {
+        return summary._def == -1;
+    }
+    // The fields start behind the prefix and its ": ".
+    return static_cast<size_t>(summary._def) < log_definitions.size() &&
+           summary._length >= timestamp_prefix_length +
+                                  log_definitions[summary._def].prefix.size() +
+                                  2;
+}
+
+LogEntry::LogEntry(const LogEntry &other) : _fields_parsed(false) {
+    *this = other;
+}
+
+LogEntry &LogEntry::operator=(const LogEntry &other) {
+    std::unique_lock<std::mutex> ul(fieldsMutexFor(&other), std::defer_lock);
+    bool parsed = other._fields_parsed.load(std::memory_order_acquire);
+    if (!parsed) {
+        ul.lock();
+        parsed = other._fields_parsed.load(std::memory_order_relaxed);
+    }
+    assign(other, parsed);
+    return *this;
+}
+
+// Nobody else can look at an entry we are moving from, so there is no
+// concurrent parseFields() to take care of.
+LogEntry::LogEntry(LogEntry &&other) noexcept : _fields_parsed(false) {
+    *this = std::move(other);
+}
+
+LogEntry &LogEntry::operator=(LogEntry &&other) noexcept {
+    assign(other, other._fields_parsed.load(std::memory_order_relaxed));
+    return *this;
+}
+
+void LogEntry::assign(const LogEntry &other, bool parsed) {
+    _lineno = other._lineno;
+    _time = other._time;
+    _logclass = other._logclass;
+    _type = other._type;
+    _state = other._state;
+    _attempt = other._attempt;
+    _host = other._host;
+    _service = other._service;
+    _contact = other._contact;
+    _command = other._command;
+    _line = other._line;
+    _line_length = other._line_length;
+    _options = other._options;
+    _def = other._def;
+    _host_name = other._host_name;
+    _svc_desc = other._svc_desc;
+    _command_name = other._command_name;
+    _contact_name = other._contact_name;
+    _state_type = other._state_type;
+    _check_output = other._check_output;
+    _comment = other._comment;
+    _fields_parsed.store(parsed, std::memory_order_relaxed);
+}
+
+void LogEntry::parseFields(MonitoringCore *mc, LogCache *log_cache) const {
+    if (_fields_parsed.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lg(fieldsMutexFor(this));
+    if (_fields_parsed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (_def != nullptr) {
+        std::string_view line = message();
+        // TODO(sp) Use boost::tokenizer instead of this index fiddling
+        size_t pos = timestamp_prefix_length + _def->prefix.size() + 2;
+        for (Param par : _def->params) {
+            size_t sep_pos = line.find(';', pos);
+            size_t end_pos =
+                sep_pos == std::string_view::npos ? line.size() : sep_pos;
+            assign(par, Field{static_cast<uint32_t>(pos),
+                              static_cast<uint32_t>(end_pos - pos)});
+            pos = sep_pos == std::string_view::npos ? line.size()
+                                                    : (sep_pos + 1);
+        }
+        applyWorkarounds();
+        resolveReferences(mc, log_cache);
+    }
+    _fields_parsed.store(true, std::memory_order_release);
+}
+
+void LogEntry::moveLineTo(char *buffer) {
+    std::memcpy(buffer, _line, _line_length);
+    _line = buffer;
+}
+
+std::string_view LogEntry::text() const {
+    return _def != nullptr ? std::string_view(_def->prefix)
+                           : message().substr(timestamp_prefix_length);
+}
+
+bool LogEntry::assign(Param par, Field field) const {
     switch (par) {
         case Param::HostName:
             this->_host_name = field;
@@ -79,19 +259,20 @@ bool LogEntry::assign(Param par, const std::string &field) {
             this->_svc_desc = field;
             break;
         case Param::HostState:
-            this->_state = static_cast<int>(parseHostState(field));
+            this->_state = static_cast<int>(parseHostState(this->field(field)));
             break;
         case Param::ServiceState:
-            this->_state = static_cast<int>(parseServiceState(field));
+            this->_state =
+                static_cast<int>(parseServiceState(this->field(field)));
             break;
         case Param::State:
-            this->_state = atoi(field.c_str());
+            this->_state = toInt(this->field(field));
             break;
         case Param::StateType:
             this->_state_type = field;
             break;
         case Param::Attempt:
-            this->_attempt = atoi(field.c_str());
+            this->_attempt = toInt(this->field(field));
             break;
         case Param::Comment:
             this->_comment = field;
@@ -255,29 +436,90 @@ std::vector<LogEntry::LogDef> LogEntry::log_definitions{
     ////////////////
     LogDef{"EXTERNAL COMMAND", Class::ext_command, LogEntryType::none, {}}};
 
-// A bit verbose, but we avoid unnecessary string copies below.
-void LogEntry::classifyLogMessage() {
-    for (const auto &def : log_definitions) {
-        if (textStartsWith(def.prefix) &&
-            _complete.compare(timestamp_prefix_length + def.prefix.size(), 2,
-                              ": ") == 0) {
-            _text = &def.prefix[0];
-            _logclass = def.log_class;
-            _type = def.log_type;
-            // TODO(sp) Use boost::tokenizer instead of this index fiddling
-            size_t pos = timestamp_prefix_length + def.prefix.size() + 2;
-            for (Param par : def.params) {
-                size_t sep_pos = _complete.find(';', pos);
-                size_t end_pos =
-                    sep_pos == std::string::npos ? _complete.size() : sep_pos;
-                assign(par, _complete.substr(pos, end_pos - pos));
-                pos = sep_pos == std::string::npos ? _complete.size()
-                                                   : (sep_pos + 1);
+// static
+uint64_t LogEntry::definitionsHash() {
+    // FNV-1a over everything a Summary's _def stands for
+    static const uint64_t hash = [] {
+        uint64_t result = 14695981039346656037ULL;
+        auto add = [&result](uint64_t value) {
+            result = (result ^ value) * 1099511628211ULL;
+        };
+        for (const auto &def : log_definitions) {
+            for (char c : def.prefix) {
+                add(static_cast<unsigned char>(c));
+            }
+            add(static_cast<uint64_t>(def.log_class) + 0x100);
+            add(static_cast<uint64_t>(def.log_type) + 0x200);
+            for (auto param : def.params) {
+                add(static_cast<uint64_t>(param) + 0x300);
+            }
+            add(0x400);
+        }
+        return result;
+    }();
+    return hash;
+}
+
+// static
+const LogEntry::LogDef *LogEntry::findDefinition(std::string_view prefix) {
+    // Built once from log_definitions, so a line is classified with a single
+    // lookup instead of comparing it against every known prefix in turn.
+    static const std::unordered_map<std::string_view, const LogDef *>
+        definitions_by_prefix = [] {
+            std::unordered_map<std::string_view, const LogDef *> result;
+            for (const auto &def : log_definitions) {
+                result.emplace(def.prefix, &def);
             }
-            return;
+            return result;
+        }();
+    auto it = definitions_by_prefix.find(prefix);
+    return it == definitions_by_prefix.end() ? nullptr : it->second;
+}
+
+// static
+const LogEntry::LogDef *LogEntry::definitionOfText(std::string_view text) {
+    // All prefixes are followed by ": " and contain no colon themselves, so
+    // the text up to the first colon is the only candidate for a prefix.
+    auto colon = text.find(':');
+    if (colon == std::string_view::npos || text.substr(colon, 2) != ": ") {
+        return nullptr;
+    }
+    return findDefinition(text.substr(0, colon));
+}
+
+// static
+int LogEntry::definitionIndexOf(std::string_view line) {
+    if (line.size() < timestamp_prefix_length) {
+        return -1;
+    }
+    const auto *def = definitionOfText(line.substr(timestamp_prefix_length));
+    return def == nullptr ? -1 : static_cast<int>(def - &log_definitions[0]);
+}
+
+// static
+int LogEntry::definitionIndexOfByScan(std::string_view line) {
+    if (line.size() < timestamp_prefix_length) {
+        return -1;
+    }
+    std::string_view text = line.substr(timestamp_prefix_length);
+    for (const auto &def : log_definitions) {
+        if (text.compare(0, def.prefix.size(), def.prefix) == 0 &&
+            text.compare(def.prefix.size(), 2, ": ") == 0) {
+            return static_cast<int>(&def - &log_definitions[0]);
         }
     }
-    _text = &_complete[timestamp_prefix_length];
+    return -1;
+}
+
+// A bit verbose, but we avoid unnecessary string copies below.
+void LogEntry::classifyLogMessage() {
+    if (const auto *def =
+            definitionOfText(message().substr(timestamp_prefix_length))) {
+        _def = def;
+        _logclass = def->log_class;
+        _type = def->log_type;
+        return;
+    }
     if (textStartsWith("LOG VERSION: 2.0")) {
         _logclass = Class::program;
         _type = LogEntryType::log_version;
@@ -289,18 +531,23 @@ void LogEntry::classifyLogMessage() {
         _type = LogEntryType::log_initial_states;
         return;
     }
-    if (textContains("starting...") || textContains("active mode...")) {
+    // Most of the remaining lines are plain info messages, don't scan them
+    // for every core state message.
+    bool ellipsis = textContains("...");
+    if (ellipsis &&
+        (textContains("starting...") || textContains("active mode..."))) {
         _logclass = Class::program;
         _type = LogEntryType::core_starting;
         return;
     }
-    if (textContains("shutting down...") || textContains("Bailing out") ||
-        textContains("standby mode...")) {
+    if ((ellipsis && (textContains("shutting down...") ||
+                      textContains("standby mode..."))) ||
+        textContains("Bailing out")) {
         _logclass = Class::program;
         _type = LogEntryType::core_stopping;
         return;
     }
-    if (textContains("restarting...")) {
+    if (ellipsis && textContains("restarting...")) {
         _logclass = Class::program;
         _type = LogEntryType::none;
         return;
@@ -310,11 +557,12 @@ void LogEntry::classifyLogMessage() {
 }
 
 bool LogEntry::textStartsWith(const std::string &what) {
-    return _complete.compare(timestamp_prefix_length, what.size(), what) == 0;
+    return message().compare(timestamp_prefix_length, what.size(), what) == 0;
 }
 
 bool LogEntry::textContains(const std::string &what) {
-    return _complete.find(what, timestamp_prefix_length) != std::string::npos;
+    return message().find(what, timestamp_prefix_length) !=
+           std::string_view::npos;
 }
 
 // The NotifyHelper class has a long, tragic history: Through a long series of
@@ -324,37 +572,37 @@ bool LogEntry::textContains(const std::string &what) {
 // fields. The net result of this tragedy is that due to legacy reasons, we have
 // to support parsing an incorrect ordering of "state type" and "command name"
 // fields. :-P
-void LogEntry::applyWorkarounds() {
+void LogEntry::applyWorkarounds() const {
     if (_logclass != Class::hs_notification ||  // no need for any workaround
-        _state_type.empty()) {                  // extremely broken line
+        _state_type._length == 0) {             // extremely broken line
         return;
     }
 
-    if (_state_type == "check-mk-notify") {
+    if (stateType() == "check-mk-notify") {
         // Ooops, we encounter one of our own buggy lines...
         std::swap(_state_type, _command_name);
     }
 
-    if (_state_type.empty()) {
+    if (_state_type._length == 0) {
         return;  // extremely broken line, even after a potential swap
     }
 
-    _state = _svc_desc.empty()
-                 ? static_cast<int>(parseHostState(_state_type))
-                 : static_cast<int>(parseServiceState(_state_type));
+    _state = _svc_desc._length == 0
+                 ? static_cast<int>(parseHostState(stateType()))
+                 : static_cast<int>(parseServiceState(stateType()));
 }
 
 namespace {
 // Ugly: Depending on where we're called, the actual state type can be in
 // parentheses at the end, e.g. "ALERTHANDLER (OK)".
-std::string extractStateType(const std::string &str) {
+std::string extractStateType(std::string_view str) {
     if (!str.empty() && str[str.size() - 1] == ')') {
         size_t lparen = str.rfind('(');
-        if (lparen != std::string::npos) {
-            return str.substr(lparen + 1, str.size() - lparen - 2);
+        if (lparen != std::string_view::npos) {
+            return std::string(str.substr(lparen + 1, str.size() - lparen - 2));
         }
     }
-    return str;
+    return std::string(str);
 }
 
 std::unordered_map<std::string, ServiceState> serviceStateTypes{
@@ -381,36 +629,47 @@ std::unordered_map<std::string, HostState> hostStateTypes{
     {"UNKNOWN", HostState::up}};
 }  // namespace
 
-ServiceState LogEntry::parseServiceState(const std::string &str) {
+ServiceState LogEntry::parseServiceState(std::string_view str) {
     auto it = serviceStateTypes.find(extractStateType(str));
     return it == serviceStateTypes.end() ? ServiceState::ok : it->second;
 }
 
-HostState LogEntry::parseHostState(const std::string &str) {
+HostState LogEntry::parseHostState(std::string_view str) {
     auto it = hostStateTypes.find(extractStateType(str));
     return it == hostStateTypes.end() ? HostState::up : it->second;
 }
 
-unsigned LogEntry::updateReferences(MonitoringCore *mc) {
+unsigned LogEntry::updateReferences(MonitoringCore *mc, LogCache *log_cache) {
+    return _fields_parsed.load(std::memory_order_acquire)
+               ? resolveReferences(mc, log_cache)
+               : 0;
+}
+
+unsigned LogEntry::resolveReferences(MonitoringCore *mc,
+                                     LogCache *log_cache) const {
     unsigned updated = 0;
-    if (!_host_name.empty()) {
+    std::string host_name(hostName());
+    if (!host_name.empty()) {
         // Older Nagios headers are not const-correct... :-P
-        _host = find_host(const_cast<char *>(_host_name.c_str()));
+        _host = find_host(const_cast<char *>(host_name.c_str()));
         updated++;
     }
-    if (!_svc_desc.empty()) {
+    if (_svc_desc._length != 0) {
+        std::string svc_desc(serviceDescription());
         // Older Nagios headers are not const-correct... :-P
-        _service = find_service(const_cast<char *>(_host_name.c_str()),
-                                const_cast<char *>(_svc_desc.c_str()));
+        _service = find_service(const_cast<char *>(host_name.c_str()),
+                                const_cast<char *>(svc_desc.c_str()));
         updated++;
     }
-    if (!_contact_name.empty()) {
+    if (_contact_name._length != 0) {
+        std::string contact_name(contactName());
         // Older Nagios headers are not const-correct... :-P
-        _contact = find_contact(const_cast<char *>(_contact_name.c_str()));
+        _contact = find_contact(const_cast<char *>(contact_name.c_str()));
         updated++;
     }
-    if (!_command_name.empty()) {
-        _command = mc->find_command(_command_name);
+    if (_command_name._length != 0) {
+        _command = log_cache->internCommand(
+            mc->find_command(std::string(commandName())));
         updated++;
     }
     return updated;
@@ -26,12 +26,15 @@
 #define LogEntry_h
 
 #include "config.h"  // IWYU pragma: keep
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "MonitoringCore.h"
 #include "nagios.h"
+class LogCache;
 
 enum class ServiceState { ok = 0, warning = 1, critical = 2, unknown = 3 };
 
@@ -108,29 +111,97 @@ public:
     time_t _time;
     Class _logclass;
     LogEntryType _type;
-    std::string _complete;  // copy of complete unsplit message
-    const char *_options;   // points into _complete after ':'
-    const char *_text;      // points into _complete or into static data
-    std::string _host_name;
-    std::string _svc_desc;
-    std::string _command_name;
-    std::string _contact_name;
-    int _state;
-    std::string _state_type;
-    int _attempt;
-    std::string _check_output;
-    std::string _comment;
-
-    host *_host;
-    service *_service;
-    contact *_contact;
-    Command _command;
-
-    // NOTE: line gets modified!
-    LogEntry(MonitoringCore *mc, size_t lineno, std::string line);
-    unsigned updateReferences(MonitoringCore *mc);
-    static ServiceState parseServiceState(const std::string &str);
-    static HostState parseHostState(const std::string &str);
+
+    // The fields below and the accessors of the fields after the type are
+    // only valid after parseFields().
+    mutable int _state;
+    mutable int _attempt;
+
+    mutable host *_host;
+    mutable service *_service;
+    mutable contact *_contact;
+    mutable const Command *_command;  // interned by the LogCache, if any
+
+    // Only the timestamp and the class of the line are parsed here. The line
+    // is only referenced, so it must outlive the entry or the entry must be
+    // moved to a copy of it, see moveLineTo().
+    LogEntry(size_t lineno, std::string_view line);
+    // What the constructor above has found out about a line, so an entry can
+    // be created for it again without looking at the line, see
+    // LogfileSnapshot. Timestamps fit into 32 bits until 2106.
+    struct Summary {
+        uint32_t _time;
+        uint32_t _length;
+        uint32_t _options;
+        int16_t _def;       // index into log_definitions, -1 for none
+        uint8_t _logclass;  // invalid_class for invalid lines
+        uint8_t _type;
+    };
+    static constexpr uint8_t invalid_class = 0xff;
+    LogEntry(size_t lineno, const char *line, const Summary &summary);
+    [[nodiscard]] Summary summary() const;
+    // False if a stored summary can't describe a line of its length, e.g.
+    // because the snapshot it comes from is corrupt.
+    static bool isPlausible(const Summary &summary);
+    // A hash of the definitions the summaries refer to, so stored summaries
+    // can be recognized as outdated when the definitions change.
+    static uint64_t definitionsHash();
+    // for LogEntryBenchmark: The index of the definition of a line's message
+    // prefix, -1 for none, found like the constructor does, or by comparing
+    // the line against all prefixes in turn, like it used to.
+    static int definitionIndexOf(std::string_view line);
+    static int definitionIndexOfByScan(std::string_view line);
+
+    // Entries are shared by the snapshots queries work on, so copying has to
+    // take care of a concurrent parseFields(). Moving doesn't.
+    LogEntry(const LogEntry &other);
+    LogEntry &operator=(const LogEntry &other);
+    LogEntry(LogEntry &&other) noexcept;
+    LogEntry &operator=(LogEntry &&other) noexcept;
+    ~LogEntry() = default;
+
+    // Splits the fields of the line and resolves the host, service, contact
+    // and command, at most once. This can be called concurrently.
+    void parseFields(MonitoringCore *mc, LogCache *log_cache) const;
+    // Resolves the references of entries with parsed fields again.
+    unsigned updateReferences(MonitoringCore *mc, LogCache *log_cache);
+    static ServiceState parseServiceState(std::string_view str);
+    static HostState parseHostState(std::string_view str);
+
+    // Copies the line to the given buffer of lineLength() bytes and
+    // references the copy from now on.
+    void moveLineTo(char *buffer);
+    [[nodiscard]] size_t lineLength() const { return _line_length; }
+
+    // complete unsplit message
+    [[nodiscard]] std::string_view message() const {
+        return {_line, _line_length};
+    }
+    // text before the colon, or the message itself for info messages
+    [[nodiscard]] std::string_view text() const;
+    // everything after the colon
+    [[nodiscard]] std::string_view options() const {
+        return message().substr(_options);
+    }
+    [[nodiscard]] std::string_view hostName() const {
+        return field(_host_name);
+    }
+    [[nodiscard]] std::string_view serviceDescription() const {
+        return field(_svc_desc);
+    }
+    [[nodiscard]] std::string_view commandName() const {
+        return field(_command_name);
+    }
+    [[nodiscard]] std::string_view contactName() const {
+        return field(_contact_name);
+    }
+    [[nodiscard]] std::string_view stateType() const {
+        return field(_state_type);
+    }
+    [[nodiscard]] std::string_view checkOutput() const {
+        return field(_check_output);
+    }
+    [[nodiscard]] std::string_view comment() const { return field(_comment); }
 
 private:
     enum class Param {
@@ -156,9 +227,36 @@ private:
 
     static std::vector<LogDef> log_definitions;
 
-    bool assign(Param par, const std::string &field);
-    void applyWorkarounds();
+    // A part of the line, the offsets are smaller and don't need updating
+    // when the line is moved.
+    struct Field {
+        uint32_t _offset;
+        uint32_t _length;
+    };
+
+    const char *_line;
+    uint32_t _line_length;
+    uint32_t _options;   // offset after ':'
+    const LogDef *_def;  // nullptr for messages without fields
+    mutable Field _host_name;
+    mutable Field _svc_desc;
+    mutable Field _command_name;
+    mutable Field _contact_name;
+    mutable Field _state_type;
+    mutable Field _check_output;
+    mutable Field _comment;
+    mutable std::atomic<bool> _fields_parsed;
+
+    [[nodiscard]] std::string_view field(Field f) const {
+        return {_line + f._offset, f._length};
+    }
+    void assign(const LogEntry &other, bool parsed);
+    bool assign(Param par, Field field) const;
+    void applyWorkarounds() const;
+    static const LogDef *findDefinition(std::string_view prefix);
+    static const LogDef *definitionOfText(std::string_view text);
     void classifyLogMessage();
+    unsigned resolveReferences(MonitoringCore *mc, LogCache *log_cache) const;
     bool textStartsWith(const std::string &what);
     bool textContains(const std::string &what);
 };
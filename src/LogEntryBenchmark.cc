@@ -0,0 +1,150 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+// A microbenchmark of the classification of log lines, i.e. of constructing a
+// LogEntry, which looks up the definition of its message prefix, and of that
+// lookup alone compared to the linear scan over all prefixes it replaced. The
+// lines are taken from the given logfiles, or from a mix resembling the
+// history of a typical site: mostly state and alert lines, some notifications,
+// commands and program messages. Build it with "make LogEntryBenchmark".
+
+#include "config.h"  // IWYU pragma: keep
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "LogEntry.h"
+
+namespace {
+const std::vector<std::pair<std::string, int>> typical_mix = {
+    {"[1600000000] CURRENT SERVICE STATE: myhost;Interface 2;OK;HARD;1;"
+     "OK - [2] (up) speed 1 Gbit/s",
+     25},
+    {"[1600000000] CURRENT HOST STATE: myhost;UP;HARD;1;"
+     "OK - 10.0.0.1: rta 0.1ms, lost 0%",
+     10},
+    {"[1600000000] SERVICE ALERT: myhost;CPU load;CRITICAL;HARD;3;"
+     "CRIT - 15min load 12.00",
+     30},
+    {"[1600000000] HOST ALERT: myhost;DOWN;SOFT;1;"
+     "PING CRITICAL - Packet loss = 100%",
+     5},
+    {"[1600000000] SERVICE NOTIFICATION: admin;myhost;Disk /var;CRITICAL;"
+     "check-mk-notify;CRIT - 95% used",
+     5},
+    {"[1600000000] EXTERNAL COMMAND: SCHEDULE_FORCED_SVC_CHECK;myhost;"
+     "Check_MK;1600000000",
+     10},
+    {"[1600000000] PASSIVE SERVICE CHECK: myhost;Check_MK;0;"
+     "OK - Agent version 2.0",
+     5},
+    {"[1600000000] Warning: The check of host 'myhost' looks like it was "
+     "orphaned (results never came back).",
+     5},
+    {"[1600000000] SERVICE FLAPPING ALERT: myhost;Uptime;STARTED; "
+     "Service appears to have started flapping",
+     3},
+    {"[1600000000] LOG VERSION: 2.0", 2},
+};
+
+std::vector<std::string> typicalLines() {
+    std::vector<std::string> lines;
+    for (const auto &[line, weight] : typical_mix) {
+        lines.insert(lines.end(), weight, line);
+    }
+    return lines;
+}
+
+bool readLines(const char *path, std::vector<std::string> &lines) {
+    std::ifstream is(path);
+    if (!is) {
+        std::cerr << "cannot open " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(is, line)) {
+        lines.push_back(line);
+    }
+    return true;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> lines;
+    for (int i = 1; i < argc; ++i) {
+        if (!readLines(argv[i], lines)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (lines.empty()) {
+        lines = typicalLines();
+    }
+
+    // about two million lines, so the result is stable
+    size_t rounds = 2000000 / lines.size() + 1;
+    size_t num_lines = rounds * lines.size();
+    auto measure = [&](const char *what, const auto &process) {
+        unsigned checksum = 0;  // keeps the compiler from dropping the work
+        auto start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            for (const auto &line : lines) {
+                checksum += process(line);
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << what << ": " << elapsed.count() / num_lines
+                  << " ns per line (checksum " << checksum << ")"
+                  << std::endl;
+    };
+
+    std::cout << num_lines << " lines" << std::endl;
+    size_t lineno = 0;
+    measure("constructing entries", [&](const std::string &line) {
+        LogEntry entry(++lineno, line);
+        return static_cast<unsigned>(entry._logclass) +
+               static_cast<unsigned>(entry._type);
+    });
+    // The prefix lookup of the constructor against the linear scan it
+    // replaced, which must find the same definitions.
+    measure("looking up prefixes", [](const std::string &line) {
+        return static_cast<unsigned>(LogEntry::definitionIndexOf(line));
+    });
+    measure("scanning prefixes", [](const std::string &line) {
+        return static_cast<unsigned>(LogEntry::definitionIndexOfByScan(line));
+    });
+
+    size_t mismatches = 0;
+    for (const auto &line : lines) {
+        if (LogEntry::definitionIndexOf(line) !=
+            LogEntry::definitionIndexOfByScan(line)) {
+            std::cerr << "prefix lookup and scan differ: " << line
+                      << std::endl;
+            mismatches++;
+        }
+    }
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
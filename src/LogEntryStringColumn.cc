@@ -0,0 +1,64 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogEntryStringColumn.h"
+#include <string_view>
+#include "LogEntry.h"
+#include "Row.h"
+
+namespace {
+std::string_view fieldOf(const LogEntry &entry,
+                         LogEntryStringColumn::Type type) {
+    switch (type) {
+        case LogEntryStringColumn::Type::message:
+            return entry.message();
+        case LogEntryStringColumn::Type::type:
+            return entry.text();
+        case LogEntryStringColumn::Type::options:
+            return entry.options();
+        case LogEntryStringColumn::Type::comment:
+            return entry.comment();
+        case LogEntryStringColumn::Type::plugin_output:
+            return entry.checkOutput();
+        case LogEntryStringColumn::Type::state_type:
+            return entry.stateType();
+        case LogEntryStringColumn::Type::service_description:
+            return entry.serviceDescription();
+        case LogEntryStringColumn::Type::host_name:
+            return entry.hostName();
+        case LogEntryStringColumn::Type::contact_name:
+            return entry.contactName();
+        case LogEntryStringColumn::Type::command_name:
+            return entry.commandName();
+    }
+    return "";  // unreachable
+}
+}  // namespace
+
+std::string LogEntryStringColumn::getValue(Row row) const {
+    if (auto entry = columnData<LogEntry>(row)) {
+        return std::string(fieldOf(*entry, _type));
+    }
+    return "";
+}
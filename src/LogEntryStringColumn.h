@@ -0,0 +1,62 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogEntryStringColumn_h
+#define LogEntryStringColumn_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <string>
+#include "StringColumn.h"
+class Row;
+
+class LogEntryStringColumn : public StringColumn {
+public:
+    enum class Type {
+        message,
+        type,
+        options,
+        comment,
+        plugin_output,
+        state_type,
+        service_description,
+        host_name,
+        contact_name,
+        command_name
+    };
+
+    LogEntryStringColumn(const std::string &name,
+                         const std::string &description, int indirect_offset,
+                         int extra_offset, int extra_extra_offset, int offset,
+                         Type lesc_type)
+        : StringColumn(name, description, indirect_offset, extra_offset,
+                       extra_extra_offset, offset)
+        , _type(lesc_type) {}
+
+    [[nodiscard]] std::string getValue(Row row) const override;
+
+private:
+    const Type _type;
+};
+
+#endif  // LogEntryStringColumn_h
@@ -0,0 +1,95 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogHostIndex.h"
+#include <string_view>
+#include <unordered_set>
+#include "LogEntry.h"
+#include "LogfileEntries.h"
+
+namespace {
+const LogHostIndex::Postings no_postings;
+
+size_t countHosts(const LogfileEntries &entries, MonitoringCore *mc,
+                  LogCache *log_cache) {
+    std::unordered_set<std::string_view> hosts;
+    for (const auto &entry : entries) {
+        entry.parseFields(mc, log_cache);
+        if (!entry.hostName().empty()) {
+            hosts.insert(entry.hostName());
+        }
+    }
+    return hosts.size();
+}
+
+// Strings short enough for the small string optimization need no heap block.
+size_t bytesOf(const std::string &str) {
+    return str.capacity() < sizeof(std::string) ? 0 : str.capacity() + 1;
+}
+
+size_t bytesOf(const LogHostIndex::Postings &postings) {
+    return postings.capacity() * sizeof(uint32_t);
+}
+}  // namespace
+
+LogHostIndex::LogHostIndex(const LogfileEntries &entries, MonitoringCore *mc,
+                           LogCache *log_cache)
+    : _hosts(countHosts(entries, mc, log_cache)), _bytes(0) {
+    uint32_t pos = 0;
+    for (const auto &entry : entries) {
+        auto host_name = entry.hostName();
+        if (!host_name.empty()) {
+            std::string host(host_name);
+            _hosts.add(host);
+            _by_host[host].push_back(pos);
+            auto service_description = entry.serviceDescription();
+            if (!service_description.empty()) {
+                _by_service[{host, std::string(service_description)}]
+                    .push_back(pos);
+            }
+        }
+        pos++;
+    }
+    // Each node of the maps has a few pointers besides its value.
+    _bytes = _hosts.bytes() + _by_host.bucket_count() * sizeof(void *);
+    for (const auto &[host, postings] : _by_host) {
+        _bytes += 2 * sizeof(void *) + sizeof(std::string) + bytesOf(host) +
+                  sizeof(Postings) + bytesOf(postings);
+    }
+    for (const auto &[key, postings] : _by_service) {
+        _bytes += 4 * sizeof(void *) + sizeof(key) + bytesOf(key.first) +
+                  bytesOf(key.second) + sizeof(Postings) + bytesOf(postings);
+    }
+}
+
+const LogHostIndex::Postings &LogHostIndex::find(
+    const std::string &host_name,
+    const std::string &service_description) const {
+    if (service_description.empty()) {
+        auto it = _by_host.find(host_name);
+        return it == _by_host.end() ? no_postings : it->second;
+    }
+    auto it = _by_service.find({host_name, service_description});
+    return it == _by_service.end() ? no_postings : it->second;
+}
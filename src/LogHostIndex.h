@@ -0,0 +1,67 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogHostIndex_h
+#define LogHostIndex_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "BloomFilter.h"
+class LogCache;
+class LogfileEntries;
+class MonitoringCore;
+
+/// An inverted index of the entries of a logfile: The positions of the
+/// entries of each host and of each service, in ascending order, plus a Bloom
+/// filter of the hosts. Building it parses the fields of all entries.
+class LogHostIndex {
+public:
+    using Postings = std::vector<uint32_t>;
+
+    LogHostIndex(const LogfileEntries &entries, MonitoringCore *mc,
+                 LogCache *log_cache);
+
+    // The entries of the given host, restricted to the given service if it
+    // is not empty.
+    [[nodiscard]] const Postings &find(const std::string &host_name,
+                                       const std::string &service_description)
+        const;
+    [[nodiscard]] const BloomFilter &hosts() const { return _hosts; }
+    // the memory used, roughly
+    [[nodiscard]] size_t bytes() const { return _bytes; }
+
+private:
+    std::unordered_map<std::string, Postings> _by_host;
+    std::map<std::pair<std::string, std::string>, Postings> _by_service;
+    BloomFilter _hosts;
+    size_t _bytes;
+};
+
+#endif  // LogHostIndex_h
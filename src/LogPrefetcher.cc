@@ -0,0 +1,70 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogPrefetcher.h"
+#include <utility>
+
+LogPrefetcher::LogPrefetcher(size_t num_threads)
+    : _num_threads(num_threads), _should_terminate(false) {}
+
+LogPrefetcher::~LogPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lg(_mutex);
+        _should_terminate = true;
+    }
+    _cond.notify_all();
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+void LogPrefetcher::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lg(_mutex);
+        _queue.push_back(std::move(job));
+        if (_threads.size() < _num_threads &&
+            _threads.size() < _queue.size()) {
+            _threads.emplace_back(&LogPrefetcher::run, this);
+        }
+    }
+    _cond.notify_one();
+}
+
+void LogPrefetcher::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> ul(_mutex);
+            while (_queue.empty() && !_should_terminate) {
+                _cond.wait(ul);
+            }
+            if (_should_terminate) {
+                return;
+            }
+            job = std::move(_queue.front());
+            _queue.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,63 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogPrefetcher_h
+#define LogPrefetcher_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A few threads loading logfiles in the background for the LogCache, so a
+/// query can scan one logfile while the next ones are read and parsed. The
+/// threads are only started when the first job arrives, jobs still queued
+/// when we are destroyed are dropped.
+class LogPrefetcher {
+public:
+    explicit LogPrefetcher(size_t num_threads);
+    ~LogPrefetcher();
+    LogPrefetcher(const LogPrefetcher &) = delete;
+    LogPrefetcher &operator=(const LogPrefetcher &) = delete;
+
+    void submit(std::function<void()> job);
+
+private:
+    const size_t _num_threads;
+    // The mutex protects all fields below, and it works together with the
+    // condition variable.
+    std::mutex _mutex;
+    std::deque<std::function<void()>> _queue;
+    bool _should_terminate;
+    std::condition_variable _cond;
+    std::vector<std::thread> _threads;
+
+    void run();
+};
+
+#endif  // LogPrefetcher_h
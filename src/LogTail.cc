@@ -0,0 +1,111 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogTail.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+LogTail::LogTail(fs::path path)
+    : _path(std::move(path)), _fd(-1), _size(0), _end(0) {
+    for (auto &slot : _slots) {
+        slot._version = 0;
+    }
+}
+
+LogTail::~LogTail() {
+    if (_fd != -1) {
+        close(_fd);
+    }
+}
+
+void LogTail::add(time_t time, const char *message) {
+    // Lines are usually added by the core's main thread, but external commands
+    // submitted via Livestatus log from our threads, so we claim a slot.
+    uint64_t seq = _end.fetch_add(1);
+    Slot &slot = _slots[seq % num_slots];
+    slot._version.store(2 * seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // The line has just been appended, so it ends at the current end of file.
+    // Should another line have been appended in between, the offset is too
+    // big, and readers see a gap.
+    struct stat st;
+    int length = snprintf(slot._text.data(), slot._text.size(), "[%lu] %s",
+                          static_cast<unsigned long>(time), message);
+    if (length < 0 || static_cast<size_t>(length) >= slot._text.size() ||
+        strchr(message, '\n') != nullptr || !statLogfile(st) ||
+        st.st_size <= length) {
+        slot._length = unusable_line;
+    } else {
+        slot._inode = st.st_ino;
+        slot._offset = st.st_size - length - 1;
+        slot._length = length;
+    }
+
+    slot._version.store(2 * seq + 2, std::memory_order_release);
+}
+
+// Each line makes the logfile grow, so if the file we have open didn't grow,
+// it has been rotated, and we have to open the new one.
+bool LogTail::statLogfile(struct stat &st) {
+    std::lock_guard<std::mutex> lg(_file_lock);
+    if (_fd != -1 && fstat(_fd, &st) == 0 && st.st_size != _size) {
+        _size = st.st_size;
+        return true;
+    }
+    if (_fd != -1) {
+        close(_fd);
+    }
+    _fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (_fd == -1 || fstat(_fd, &st) == -1) {
+        return false;
+    }
+    _size = st.st_size;
+    return true;
+}
+
+uint64_t LogTail::begin() const {
+    // The slot after the last line might be overwritten already.
+    uint64_t end = _end.load();
+    return end < num_slots ? 0 : end - num_slots + 1;
+}
+
+bool LogTail::get(uint64_t seq, Line &line) const {
+    const Slot &slot = _slots[seq % num_slots];
+    if (slot._version.load(std::memory_order_acquire) != 2 * seq + 2) {
+        return false;
+    }
+    size_t length = slot._length;
+    if (length == unusable_line) {
+        return false;
+    }
+    line._inode = slot._inode;
+    line._offset = slot._offset;
+    line._text.assign(slot._text.data(), length);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot._version.load(std::memory_order_relaxed) == 2 * seq + 2;
+}
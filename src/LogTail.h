@@ -0,0 +1,99 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogTail_h
+#define LogTail_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "FileSystem.h"
+
+/// The most recent lines of the current logfile, as reported by the core right
+/// after writing them. Readers never lock anything: Each slot of the ring is
+/// guarded by a sequence number, and a reader simply fails when the slot it
+/// wants has been overwritten in the meantime. Lines which don't fit into a
+/// slot are not kept, so readers see a gap and have to read the file instead.
+class LogTail {
+public:
+    static constexpr size_t num_slots = 2048;
+    static constexpr size_t max_line_length = 1024;
+
+    struct Line {
+        ino_t _inode;       // inode of the logfile
+        off_t _offset;      // where the line starts in the logfile
+        std::string _text;  // without the trailing newline
+    };
+
+    explicit LogTail(fs::path path);
+    ~LogTail();
+    LogTail(const LogTail &) = delete;
+    LogTail &operator=(const LogTail &) = delete;
+
+    // Called by the core after writing "[<time>] <message>\n" to the logfile.
+    void add(time_t time, const char *message);
+
+    // The sequence numbers of the lines still available are [begin, end).
+    [[nodiscard]] uint64_t begin() const;
+    [[nodiscard]] uint64_t end() const { return _end.load(); }
+
+    // Copies the line with the given sequence number. Returns false if it is
+    // not available (anymore).
+    bool get(uint64_t seq, Line &line) const;
+
+private:
+    static constexpr size_t unusable_line = ~size_t{0};
+
+    struct Slot {
+        // 2 * seq + 1 while line number seq is written, 2 * seq + 2 afterwards
+        std::atomic<uint64_t> _version;
+        ino_t _inode;
+        off_t _offset;
+        size_t _length;  // unusable_line if it did not fit
+        std::array<char, max_line_length> _text;
+    };
+
+    const fs::path _path;
+    // The logfile is kept open, so we don't have to look it up by name for
+    // each line. The mutex protects the fields below, it is only contended
+    // when our threads log, too, e.g. external commands.
+    std::mutex _file_lock;
+    int _fd;
+    off_t _size;  // the size when we looked the last time
+
+    std::atomic<uint64_t> _end;
+    std::array<Slot, num_slots> _slots;
+
+    bool statLogfile(struct stat &st);
+};
+
+#endif  // LogTail_h
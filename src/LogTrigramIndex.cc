@@ -0,0 +1,79 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogTrigramIndex.h"
+#include <algorithm>
+#include <cctype>
+#include "LogEntry.h"
+#include "LogfileEntries.h"
+
+namespace {
+template <typename F>
+void forEachTrigram(std::string_view text, F f) {
+    uint32_t trigram = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        auto c = static_cast<unsigned char>(text[i]);
+        trigram = ((trigram << 8) | std::tolower(c)) & 0xffffffU;
+        if (i >= 2) {
+            f(trigram);
+        }
+    }
+}
+}  // namespace
+
+LogTrigramIndex::LogTrigramIndex(const LogfileEntries &entries)
+    : _bits((entries.size() + segment_size - 1) / segment_size *
+            words_per_segment) {
+    size_t pos = 0;
+    for (const auto &entry : entries) {
+        uint64_t *segment = &_bits[pos / segment_size * words_per_segment];
+        forEachTrigram(entry.message(), [segment](uint32_t trigram) {
+            size_t bit = bitFor(trigram);
+            segment[bit / 64] |= 1ULL << bit % 64;
+        });
+        pos++;
+    }
+}
+
+// static
+size_t LogTrigramIndex::bitFor(uint32_t trigram) {
+    return static_cast<uint32_t>(trigram * 0x9E3779B1U) >> 21;
+}
+
+// static
+LogTrigramIndex::Trigrams LogTrigramIndex::trigramsOf(std::string_view text) {
+    Trigrams result;
+    forEachTrigram(text, [&](uint32_t trigram) { result.push_back(trigram); });
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+bool LogTrigramIndex::mightContain(size_t pos, const Trigrams &trigrams) const {
+    const uint64_t *segment = &_bits[pos / segment_size * words_per_segment];
+    return std::all_of(trigrams.begin(), trigrams.end(), [segment](uint32_t t) {
+        size_t bit = bitFor(t);
+        return (segment[bit / 64] & (1ULL << bit % 64)) != 0;
+    });
+}
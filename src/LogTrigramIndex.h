@@ -0,0 +1,65 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogTrigramIndex_h
+#define LogTrigramIndex_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+class LogfileEntries;
+
+/// A coarse full-text index of the entries of a logfile: For each segment of a
+/// few consecutive entries, a Bloom filter of the trigrams of their messages,
+/// ignoring the case of ASCII letters. A search for a text only has to look at
+/// the segments which might contain all of its trigrams. This costs about 16
+/// bytes per entry.
+class LogTrigramIndex {
+public:
+    using Trigrams = std::vector<uint32_t>;
+    static constexpr size_t segment_size = 16;
+
+    explicit LogTrigramIndex(const LogfileEntries &entries);
+
+    // The trigrams of a text to search for, empty if it is too short.
+    static Trigrams trigramsOf(std::string_view text);
+
+    // Whether the messages in the segment of the entry at the given position
+    // might contain all of the trigrams.
+    [[nodiscard]] bool mightContain(size_t pos, const Trigrams &trigrams) const;
+
+    [[nodiscard]] size_t bytes() const {
+        return _bits.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr size_t words_per_segment = 32;  // 2048 bits
+    std::vector<uint64_t> _bits;
+
+    static size_t bitFor(uint32_t trigram);
+};
+
+#endif  // LogTrigramIndex_h
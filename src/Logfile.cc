@@ -26,22 +26,40 @@
 // IWYU pragma: no_include <ext/alloc_traits.h>
 #include "Logfile.h"
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include "LogCache.h"
 #include "LogEntry.h"
+#include "LogHostIndex.h"
+#include "LogTail.h"
+#include "LogTrigramIndex.h"
+#include "LogfileEntries.h"
+#include "LogfileSnapshot.h"
 #include "Logger.h"
 #include "MonitoringCore.h"
 #include "Query.h"
 #include "Row.h"
+#include "global_counters.h"
 
 #ifdef CMC
 #include "cmc.h"
 #endif
 
 namespace {
+// the time range of all lines
+constexpr time_t earliest = std::numeric_limits<time_t>::min();
+constexpr time_t latest = std::numeric_limits<time_t>::max();
+
 time_t firstTimestampOf(const fs::path &path, Logger *logger) {
     std::ifstream is(path, std::ios::binary);
     if (!is) {
@@ -65,6 +83,110 @@ time_t firstTimestampOf(const fs::path &path, Logger *logger) {
     line[11] = 0;
     return atoi(line + 1);
 }
+// An open file, closed automatically.
+class FileDescriptor {
+public:
+    FileDescriptor(const fs::path &path, Logger *logger)
+        : _fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+        if (_fd == -1) {
+            generic_error ge("cannot open logfile " + path.string());
+            Informational(logger) << ge;
+        }
+    }
+    ~FileDescriptor() {
+        if (_fd != -1) {
+            close(_fd);
+        }
+    }
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+    explicit operator bool() const { return _fd != -1; }
+    [[nodiscard]] int get() const { return _fd; }
+
+private:
+    int _fd;
+};
+
+// Calls process(line, line_offset) for the lines in the byte range [offset,
+// end) of a file, without the trailing newlines, until it returns false.
+// Returns the offset behind the last line processed.
+//
+// Archives don't change, so we map them into memory and split the lines right
+// there. The current logfile could be truncated under our feet, which would
+// be answered by a SIGBUS if it was mapped, so we read it in big chunks
+// instead and leave an incomplete last line alone until it is complete.
+template <typename Process>
+off_t forEachLine(int fd, off_t offset, off_t end, bool growing,
+                  Process process) {
+    if (offset >= end) {
+        return offset;
+    }
+    posix_fadvise(fd, offset, end - offset, POSIX_FADV_SEQUENTIAL);
+    if (!growing) {
+        off_t map_offset = offset - offset % sysconf(_SC_PAGESIZE);
+        auto length = static_cast<size_t>(end - map_offset);
+        void *addr =
+            mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, map_offset);
+        if (addr != MAP_FAILED) {
+            madvise(addr, length, MADV_SEQUENTIAL);
+            const char *data = static_cast<const char *>(addr);
+            auto pos = static_cast<size_t>(offset - map_offset);
+            while (pos < length) {
+                auto nl = static_cast<const char *>(
+                    memchr(data + pos, '\n', length - pos));
+                size_t line_end = nl == nullptr ? length : nl - data;
+                if (!process(std::string_view(data + pos, line_end - pos),
+                             map_offset + static_cast<off_t>(pos))) {
+                    break;
+                }
+                pos = nl == nullptr ? length : line_end + 1;
+            }
+            munmap(addr, length);
+            return map_offset + static_cast<off_t>(pos);
+        }
+    }
+
+    std::vector<char> buffer(1024 * 1024);
+    off_t buffer_offset = offset;  // file offset of the buffer's start
+    size_t used = 0;
+    while (true) {
+        if (used == buffer.size()) {
+            buffer.resize(2 * buffer.size());  // very long line
+        }
+        auto wanted = std::min(static_cast<off_t>(buffer.size() - used),
+                               end - buffer_offset - static_cast<off_t>(used));
+        ssize_t count = wanted == 0 ? 0
+                                    : pread(fd, buffer.data() + used, wanted,
+                                            buffer_offset + used);
+        bool at_end = count <= 0;
+        if (!at_end) {
+            used += count;
+        }
+        size_t pos = 0;
+        while (auto nl = static_cast<const char *>(
+                   memchr(buffer.data() + pos, '\n', used - pos))) {
+            size_t line_end = nl - buffer.data();
+            if (!process(std::string_view(buffer.data() + pos, line_end - pos),
+                         buffer_offset + static_cast<off_t>(pos))) {
+                return buffer_offset + static_cast<off_t>(pos);
+            }
+            pos = line_end + 1;
+        }
+        if (at_end) {
+            if (!growing && pos < used &&
+                process(std::string_view(buffer.data() + pos, used - pos),
+                        buffer_offset + static_cast<off_t>(pos))) {
+                pos = used;
+            }
+            return buffer_offset + static_cast<off_t>(pos);
+        }
+        // keep the incomplete line at the end for the next round
+        std::copy(buffer.begin() + pos, buffer.begin() + used, buffer.begin());
+        used -= pos;
+        buffer_offset += static_cast<off_t>(pos);
+    }
+}
 }  // namespace
 
 Logfile::Logfile(MonitoringCore *mc, LogCache *logcache, fs::path path,
@@ -74,163 +196,613 @@ Logfile::Logfile(MonitoringCore *mc, LogCache *logcache, fs::path path,
     , _path(std::move(path))
     , _since(firstTimestampOf(_path, logger()))
     , _watch(watch)
-    , _read_pos{}
+    , _read_pos(0)
     , _lineno(0)
+    , _inode(0)
+    , _tail_seq(0)
+    , _entries(std::make_shared<LogfileEntries>())
+    , _sidecars_read(false)
+    , _read_since(earliest)
+    , _read_until(latest)
 #ifdef CMC
     , _world(nullptr)
 #endif
-    , _logclasses_read(0) {
-}
+    , _logclasses_read(0)
+    , _host_filter_classes(0)
+    , _writes_sidecars(true)
+    , _num_cached_messages(0)
+    , _num_cached_bytes(0)
+    , _hits(0)
+    , _misses(0)
+    , _last_use(0) {}
+
+Logfile::~Logfile() = default;
 
-void Logfile::flush() {
-    _entries.clear();
+size_t Logfile::flush() {
+    std::unique_lock<std::mutex> ul(_lock, std::try_to_lock);
+    if (!ul.owns_lock() || _entries->empty()) {
+        return 0;
+    }
+    size_t freed = _entries->size();
+    _entries = std::make_shared<LogfileEntries>();
     _logclasses_read = 0;
+    updateStatistics();
+    return freed;
+}
+
+void Logfile::takeOver(Logfile &previous) {
+    std::lock_guard<std::mutex> lg(previous._lock);
+    // Both logfiles share the entries now, so they are copied on write.
+    _entries = previous._entries;
+    _read_pos = previous._read_pos;
+    _lineno = previous._lineno;
+#ifdef CMC
+    _world = previous._world;
+#endif
+    _logclasses_read = previous._logclasses_read;
+    _read_since = earliest;
+    _read_until = latest;
+    _hits = previous.hits();
+    _misses = previous.misses();
+    _last_use = previous.lastUse();
+    updateStatistics();
 }
 
-void Logfile::load(unsigned logclasses) {
+void Logfile::writeSidecars() {
+    std::lock_guard<std::mutex> lg(_lock);
+    if (_watch) {
+        return;
+    }
+    readSidecars();
+    if (_index && _snapshot) {
+        return;
+    }
+    FileDescriptor fd(_path, logger());
+    struct stat st;
+    if (!fd || fstat(fd.get(), &st) == -1) {
+        return;
+    }
+    LogfileIndex index;
+    LogfileSnapshot snapshot;
+    size_t lineno = 0;
+    forEachLine(fd.get(), 0, st.st_size, false,
+                [&](std::string_view line, off_t line_offset) {
+                    if (lineno >= _mc->maxLinesPerLogFile()) {
+                        return false;
+                    }
+                    LogEntry entry(++lineno, line);
+                    index.addLine(line_offset, lineno - 1, entry._time,
+                                  static_cast<int>(entry._logclass));
+                    snapshot.addLine(line_offset, entry);
+                    return true;
+                });
+    if (lineno < _mc->maxLinesPerLogFile()) {
+        index.write(_path, logger());
+        snapshot.write(_path, logger());
+        _index = LogfileIndex::read(_path, logger());
+        // The time range read so far might need the snapshot.
+        if (auto written = LogfileSnapshot::read(_path, logger())) {
+            _snapshot = std::move(written);
+        }
+    }
+}
+
+void Logfile::readSidecars() {
+    if (!_sidecars_read) {
+        _index = LogfileIndex::read(_path, logger());
+        _snapshot = LogfileSnapshot::read(_path, logger());
+        _sidecars_read = true;
+    }
+}
+
+size_t Logfile::load(unsigned logclasses, time_t since, time_t until) {
+    if (!_watch) {
+        return loadArchive(logclasses, since, until);
+    }
     unsigned missing_types = logclasses & ~_logclasses_read;
     // The current logfile has the _watch flag set to true.
     // In that case, if the logfile has grown, we need to
     // load the rest of the file, even if no logclasses
-    // are missing.
-    if (_watch) {
-        FILE *file = fopen(_path.c_str(), "r");
-        if (file == nullptr) {
-            generic_error ge("cannot open logfile " + _path.string());
-            Informational(logger()) << ge;
-            return;
-        }
-        // If we read this file for the first time, we initialize
-        // the current file position to 0
-        if (_lineno == 0) {
-            fgetpos(file, &_read_pos);
-        }
+    // are missing. Usually the core has told us about the
+    // new lines already, so we don't need the file.
+    size_t added = 0;
+    if (_logclasses_read != 0U && missing_types == 0U &&
+        loadFromTail(added)) {
+        return added;
+    }
+
+    // Everything reported from now on is at or behind what we read below.
+    _tail_seq = _logcache->tail().end();
+    FileDescriptor fd(_path, logger());
+    if (!fd) {
+        return added;
+    }
+    struct stat st;
+    if (fstat(fd.get(), &st) == 0) {
+        _inode = st.st_ino;
+    }
+
+    // file might have grown. Read all classes that we already
+    // have read to the end of the file
+    off_t end = -1;
+    if (_logclasses_read != 0U) {
+        added += loadRange(fd.get(), _read_pos, -1, _logclasses_read, nullptr,
+                           nullptr);
+        end = _read_pos;
+    }
+    if (missing_types != 0U) {
+        _misses++;
+        // Read up to where the other classes have been read, so all classes
+        // continue at the same position next time.
+        off_t offset = 0;
+        _lineno = 0;
+        added += loadRange(fd.get(), offset, end, missing_types, nullptr,
+                           nullptr);
+        _logclasses_read |= missing_types;
+        _read_pos = offset;  // remember current end of file
+    }
+    return added;
+}
+
+size_t Logfile::loadArchive(unsigned logclasses, time_t since,
+                            time_t until) {
+    readSidecars();
+    // With an index, we can skip classes without any line in this file, with
+    // a snapshot the lines outside of the time range, too.
+    unsigned missing_types = logclasses & ~_logclasses_read;
+    if (_index) {
+        missing_types &= _index->classes();
+    }
+    if (!_snapshot || since <= _snapshot->minTime()) {
+        since = earliest;
+    }
+    if (!_snapshot || until >= _snapshot->maxTime()) {
+        until = latest;
+    }
+    bool extend = _logclasses_read != 0U &&
+                  (since < _read_since || until > _read_until);
+    bool catch_up = _logclasses_read != 0U && _read_pos != 0;
+    if (missing_types == 0 && !extend && !catch_up) {
+        return 0;
+    }
+
+    _misses++;
+    FileDescriptor fd(_path, logger());
+    if (!fd) {
+        return 0;
+    }
+    // Only the snapshot can skip the lines outside of a time range.
+    auto load_range = [&](unsigned classes, time_t from, time_t to) {
+        off_t offset = _index ? _index->startFor(from)._offset : 0;
+        return loadSnapshotRange(fd.get(), offset, -1, classes, from, to);
+    };
 
-        // file might have grown. Read all classes that we already
-        // have read to the end of the file
-        if (_logclasses_read != 0U) {
-            fsetpos(file, &_read_pos);  // continue at previous end
-            loadRange(file, _logclasses_read, logclasses);
-            fgetpos(file, &_read_pos);
+    size_t added = 0;
+    if (catch_up) {
+        // the lines appended after we have read the current logfile
+        added += loadRange(fd.get(), _read_pos, -1, _logclasses_read, nullptr,
+                           nullptr);
+        _read_pos = 0;
+    }
+    if (_logclasses_read == 0U) {
+        _read_since = since;
+        _read_until = until;
+    } else if (extend) {
+        // load the older and newer lines of the classes we already have
+        if (since < _read_since) {
+            added += load_range(_logclasses_read, since, _read_since - 1);
+            _read_since = since;
         }
-        if (missing_types != 0U) {
-            fseek(file, 0, SEEK_SET);
-            _lineno = 0;
-            loadRange(file, missing_types, logclasses);
-            _logclasses_read |= missing_types;
-            fgetpos(file, &_read_pos);  // remember current end of file
+        if (until > _read_until) {
+            added += load_range(_logclasses_read, _read_until + 1, until);
+            _read_until = until;
         }
-        fclose(file);
-    } else {
-        if (missing_types == 0) {
-            return;
+    }
+    if (missing_types != 0U) {
+        if (_snapshot) {
+            added += load_range(missing_types, _read_since, _read_until);
+        } else if (!_writes_sidecars) {
+            off_t offset = 0;
+            _lineno = 0;
+            added += loadRange(fd.get(), offset, -1, missing_types, nullptr,
+                               nullptr);
+        } else {
+            // We read the whole file, so we build the index and the snapshot
+            // on the way.
+            auto index = std::make_unique<LogfileIndex>();
+            auto snapshot = std::make_unique<LogfileSnapshot>();
+            off_t offset = 0;
+            _lineno = 0;
+            added += loadRange(fd.get(), offset, -1, missing_types,
+                               index.get(), snapshot.get());
+            if (_lineno < _mc->maxLinesPerLogFile()) {
+                index->write(_path, logger());
+                _index = std::move(index);
+                snapshot->write(_path, logger());
+                _snapshot = LogfileSnapshot::read(_path, logger());
+            }
         }
+        _logclasses_read |= missing_types;
+    }
+    return added;
+}
 
-        FILE *file = fopen(_path.c_str(), "r");
-        if (file == nullptr) {
-            generic_error ge("cannot open logfile " + _path.string());
+// Reads the lines from offset up to the given end offset or the end of file
+// (if negative), and advances offset behind the last line read.
+size_t Logfile::loadRange(int fd, off_t &offset, off_t end,
+                          unsigned missing_types, LogfileIndex *index,
+                          LogfileSnapshot *snapshot) {
+    if (_snapshot && index == nullptr && snapshot == nullptr) {
+        return loadSnapshotRange(fd, offset, end, missing_types, earliest,
+                                 latest);
+    }
+    if (end < 0) {
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            generic_error ge("cannot stat logfile " + _path.string());
             Informational(logger()) << ge;
-            return;
+            return 0;
         }
+        end = st.st_size;
+    }
+    size_t added = 0;
+    offset = forEachLine(fd, offset, end, _watch,
+                         [&](std::string_view line, off_t line_offset) {
+                             return addLine(line, line_offset, missing_types,
+                                            index, snapshot, added);
+                         });
+    if (added != 0) {
+        sortEntries();
+    }
+    return added;
+}
 
-        _lineno = 0;
-        loadRange(file, missing_types, logclasses);
-        _logclasses_read |= missing_types;
-        fclose(file);
-    }
-}
-
-void Logfile::loadRange(FILE *file, unsigned missing_types,
-                        unsigned logclasses) {
-    std::vector<char> linebuffer(65536);
-    // TODO(sp) We should really use C++ I/O here...
-    while (fgets(&linebuffer[0], static_cast<int>(linebuffer.size()), file) !=
-           nullptr) {
-        if (_lineno >= _mc->maxLinesPerLogFile()) {
-            Error(logger()) << "more than " << _mc->maxLinesPerLogFile()
-                            << " lines in " << _path << ", ignoring the rest!";
-            return;
-        }
-        _lineno++;
-        // remove trailing newline (should be nuked, see above)
-        for (auto &ch : linebuffer) {
-            if (ch == '\0' || ch == '\n') {
-                ch = '\0';
-                break;
+// Like loadRange(), but the lines have already been split and classified by
+// the snapshot, so only the blocks and lines of the missing classes and the
+// given time range are touched.
+size_t Logfile::loadSnapshotRange(int fd, off_t &offset, off_t end,
+                                  unsigned missing_types, time_t since,
+                                  time_t until) {
+    off_t size = _snapshot->fileSize();
+    if (end < 0 || end > size) {
+        end = size;
+    }
+    size_t first = _snapshot->lineAt(offset);
+    size_t last = _snapshot->lineAt(end);
+    if (first >= last) {
+        return 0;
+    }
+    void *addr =
+        mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        generic_error ge("cannot map logfile " + _path.string());
+        Informational(logger()) << ge;
+        return 0;
+    }
+    const char *data = static_cast<const char *>(addr);
+    size_t added = 0;
+    _snapshot->forEachLine(
+        first, last, missing_types, since, until,
+        [&](size_t i, off_t line_offset, const LogEntry::Summary &summary) {
+            if (addEntry(LogEntry(i + 1, data + line_offset, summary),
+                         missing_types)) {
+                added++;
             }
+        });
+    munmap(addr, static_cast<size_t>(size));
+    _lineno = last;
+    offset = _snapshot->offsetOf(last);
+    if (added != 0) {
+        sortEntries();
+    }
+    return added;
+}
+
+// Takes the lines appended to the current logfile from the tail kept by the
+// LogCache. Returns false if the tail doesn't have all of them, e.g. because
+// we have fallen behind or a line was too long, so the rest must be read from
+// the file.
+bool Logfile::loadFromTail(size_t &added) {
+    const LogTail &tail = _logcache->tail();
+    uint64_t end = tail.end();
+    // Nothing reported at all: Maybe the core doesn't report its lines.
+    if (end == 0 || _tail_seq < tail.begin()) {
+        return false;
+    }
+    size_t added_from_tail = 0;
+    bool complete = true;
+    LogTail::Line line;
+    for (; _tail_seq < end; ++_tail_seq) {
+        if (!tail.get(_tail_seq, line)) {
+            complete = false;
+            break;
+        }
+        // Skip the lines we have read from the file already and the lines of
+        // the next logfile after a rotation.
+        if (line._inode != _inode || line._offset < _read_pos) {
+            continue;
         }
-        if (processLogLine(_lineno, &linebuffer[0], missing_types)) {
-            _logcache->logLineHasBeenAdded(this, logclasses);
+        if (line._offset != _read_pos ||
+            !addLine(line._text, line._offset, _logclasses_read, nullptr,
+                     nullptr, added_from_tail)) {
+            complete = false;
+            break;
         }
+        _read_pos += static_cast<off_t>(line._text.size()) + 1;
     }
+    if (added_from_tail != 0) {
+        sortEntries();
+    }
+    added += added_from_tail;
+    return complete;
 }
 
-long Logfile::freeMessages(unsigned logclasses) {
-    long freed = 0;
-    // We have to be careful here: Erasing an element from an associative
-    // container invalidates the iterator pointing to it. The solution is the
-    // usual post-increment idiom, see Scott Meyers' "Effective STL", item 9
-    // ("Choose carefully among erasing options.").
-    for (auto it = _entries.begin(); it != _entries.end();) {
-        if (((1U << static_cast<int>(it->second->_logclass)) & logclasses) !=
-            0U) {
-            _entries.erase(it++);
-            freed++;
-        } else {
-            ++it;
-        }
+// Adds an entry for the next line if it has one of the given classes, and
+// the line to the index and the snapshot, if any. Returns false if there are
+// too many lines.
+bool Logfile::addLine(std::string_view line, off_t line_offset,
+                      unsigned logclasses, LogfileIndex *index,
+                      LogfileSnapshot *snapshot, size_t &added) {
+    if (_lineno >= _mc->maxLinesPerLogFile()) {
+        Error(logger()) << "more than " << _mc->maxLinesPerLogFile()
+                        << " lines in " << _path << ", ignoring the rest!";
+        return false;
+    }
+    LogEntry entry(++_lineno, line);
+    if (index != nullptr) {
+        index->addLine(line_offset, _lineno - 1, entry._time,
+                       static_cast<int>(entry._logclass));
+    }
+    if (snapshot != nullptr) {
+        snapshot->addLine(line_offset, entry);
+    }
+    if (addEntry(entry, logclasses)) {
+        added++;
     }
+    return true;
+}
+
+void Logfile::sortEntries() {
+    if (size_t dropped = mutableEntries().sort()) {
+        // this should never happen. The lineno must be unique!
+        Error(logger()) << "dropped " << dropped
+                        << " strange duplicate logfile lines of " << _path;
+    }
+}
+
+size_t Logfile::freeMessages(unsigned logclasses) {
+    std::unique_lock<std::mutex> ul(_lock, std::try_to_lock);
+    if (!ul.owns_lock() || (_logclasses_read & logclasses) == 0U) {
+        return 0;
+    }
+    Debug(logger()) << "freeing classes " << logclasses << " of file "
+                    << _path;
+    auto entries = _entries->without(logclasses);
+    size_t freed = _entries->size() - entries->size();
+    _entries = std::move(entries);
     _logclasses_read &= ~logclasses;
+    updateStatistics();
     return freed;
 }
 
-bool Logfile::processLogLine(size_t lineno, std::string line,
-                             unsigned logclasses) {
-    auto entry = std::make_unique<LogEntry>(_mc, lineno, std::move(line));
-    // ignored invalid lines
-    if (entry->_logclass == LogEntry::Class::invalid) {
-        return false;
+size_t Logfile::freeOlderHalf() {
+    std::unique_lock<std::mutex> ul(_lock, std::try_to_lock);
+    if (!ul.owns_lock() || _watch || !_snapshot || _read_pos != 0 ||
+        _entries->empty()) {
+        return 0;
     }
-    if (((1U << static_cast<int>(entry->_logclass)) & logclasses) == 0U) {
+    time_t first = _entries->begin()->_time;
+    time_t last = (_entries->end() - 1)->_time;
+    if (first == last) {
+        return 0;
+    }
+    time_t middle = first + (last - first) / 2;
+    Debug(logger()) << "freeing entries until " << middle << " of file "
+                    << _path;
+    auto entries = _entries->since(middle + 1);
+    size_t freed = _entries->size() - entries->size();
+    _entries = std::move(entries);
+    _read_since = std::max(_read_since, middle + 1);
+    updateStatistics();
+    return freed;
+}
+
+bool Logfile::addEntry(const LogEntry &entry, unsigned logclasses) {
+    // ignored invalid lines
+    if (entry._logclass == LogEntry::Class::invalid) {
         return false;
     }
-    uint64_t key = makeKey(entry->_time, entry->_lineno);
-    if (_entries.find(key) != _entries.end()) {
-        // this should never happen. The lineno must be unique!
-        Error(logger()) << "strange duplicate logfile line "
-                        << entry->_complete;
+    if (((1U << static_cast<int>(entry._logclass)) & logclasses) == 0U) {
         return false;
     }
-    _entries[key] = std::move(entry);
+    mutableEntries().add(entry);
     return true;
 }
 
-const logfile_entries_t *Logfile::getEntriesFor(unsigned logclasses) {
-    // Make sure existing references to objects point to correct world
-    updateReferences();
-    // make sure all messages are present
-    load(logclasses);
-    return &_entries;
+LogfileEntries &Logfile::mutableEntries() {
+    // Nobody can take a new snapshot while we hold the lock, so if we are the
+    // only owner, we can modify the entries in place. The copy shares the
+    // segments of the entries, so this is cheap.
+    if (_entries.use_count() > 1) {
+        _entries = std::make_shared<LogfileEntries>(*_entries);
+    }
+    return *_entries;
+}
+
+std::shared_ptr<const LogfileEntries> Logfile::getEntriesFor(
+    unsigned logclasses) {
+    return getEntriesFor(logclasses, earliest, latest);
+}
+
+// Archives might contain only the entries of the given time range, plus some
+// others.
+std::shared_ptr<const LogfileEntries> Logfile::getEntriesFor(
+    unsigned logclasses, time_t since, time_t until) {
+    size_t added = 0;
+    std::shared_ptr<const LogfileEntries> entries;
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        // Make sure existing references to objects point to correct world
+        updateReferences();
+        // make sure all messages are present
+        _last_use = _logcache->tick();
+        unsigned long misses = _misses;
+        added = load(logclasses, since, until);
+        if (_misses == misses) {
+            _hits++;
+            counterIncrement(Counter::log_cache_hits);
+        } else {
+            counterIncrement(Counter::log_cache_misses);
+        }
+        updateStatistics();
+        entries = _entries;
+    }
+    // Eviction needs the locks of other logfiles, so we must not hold ours.
+    if (added != 0) {
+        _logcache->logLinesHaveBeenAdded(this, added, logclasses);
+    }
+    return entries;
+}
+
+std::shared_ptr<const LogfileEntries> Logfile::readEntriesFor(
+    unsigned logclasses) {
+    if (_watch) {
+        return getEntriesFor(logclasses);
+    }
+    {
+        std::lock_guard<std::mutex> lg(_lock);
+        readSidecars();
+        unsigned missing_types = logclasses & ~_logclasses_read;
+        if (_index) {
+            missing_types &= _index->classes();
+        }
+        if (missing_types == 0 && _read_pos == 0 &&
+            (_logclasses_read == 0 ||
+             (_read_since == earliest && _read_until == latest))) {
+            updateReferences();
+            return _entries;
+        }
+    }
+    // A logfile of our own, which the LogCache doesn't know about. It must
+    // not write the sidecars while we might be writing them, too.
+    Logfile transient(_mc, _logcache, _path, false);
+    std::lock_guard<std::mutex> lg(transient._lock);
+    transient._writes_sidecars = false;
+    transient.updateReferences();
+    transient.load(logclasses, earliest, latest);
+    return transient._entries;
 }
 
-bool Logfile::answerQueryReverse(Query *query, time_t since, time_t until,
-                                 unsigned logclasses) {
-    auto entries = getEntriesFor(logclasses);
-    // TODO(sp) Move the stuff below out of this class. Tricky part: makeKey
-    auto it = entries->upper_bound(makeKey(until, 999999999));
+void Logfile::prefetch(unsigned logclasses, time_t since) {
+    getEntriesFor(logclasses, since, latest);
+}
+
+bool Logfile::answerQueryReverse(
+    Query *query, time_t since, time_t until, unsigned logclasses,
+    bool parse_fields, const std::optional<std::string> &host_name,
+    const std::optional<std::string> &service_description,
+    const LogTrigramIndex::Trigrams &trigrams) {
+    // Without the host, we are done if the file starts before the time range.
+    if (host_name && !mightMentionHost(*host_name, logclasses)) {
+        return _since >= since;
+    }
+    auto entries = getEntriesFor(logclasses, since, until);
+    std::shared_ptr<const LogTrigramIndex> trigram_index;
+    if (!trigrams.empty()) {
+        trigram_index = entries->trigramIndex();
+        updateStatistics(entries);
+    }
+    auto might_match = [&](size_t pos) {
+        return !trigram_index || trigram_index->mightContain(pos, trigrams);
+    };
+
+    // TODO(sp) Move the stuff below out of this class.
+    auto it = entries->upperBound(until);
+    if (host_name) {
+        auto index = entries->hostIndex(_mc, _logcache);
+        updateStatistics(entries);
+        rememberHosts(entries, index->hosts());
+        const auto &postings = index->find(
+            *host_name, service_description.value_or(std::string()));
+        auto pos = std::lower_bound(
+            postings.begin(), postings.end(),
+            static_cast<uint32_t>(it - entries->begin()));
+        while (pos != postings.begin()) {
+            --pos;
+            const LogEntry &entry = *(entries->begin() + *pos);
+            if (entry._time < since) {
+                return false;
+            }
+            if (might_match(*pos) && !query->processDataset(Row(&entry))) {
+                return false;
+            }
+        }
+        return entries->empty() || (entries->begin()->_time >= since &&
+                                    !skippedLinesBefore(since));
+    }
     while (it != entries->begin()) {
         --it;
-        // end found or limit exceeded?
-        if (it->second->_time < since ||
-            !query->processDataset(Row(it->second.get()))) {
+        // end found?
+        if (it->_time < since) {
+            return false;
+        }
+        // Skip the rest of a segment which can't contain the text searched
+        // for. The next entry we look at is older than the skipped ones.
+        auto pos = static_cast<size_t>(it - entries->begin());
+        if (!might_match(pos)) {
+            it -= pos % LogTrigramIndex::segment_size;
+            continue;
+        }
+        if (parse_fields) {
+            it->parseFields(_mc, _logcache);
+        }
+        // limit exceeded?
+        if (!query->processDataset(Row(&*it))) {
             return false;
         }
     }
-    return true;
+    return !skippedLinesBefore(since);
+}
+
+// The end of the time range is found at the first line before it, even when
+// the snapshot let us skip that line, so we get the same answer as with the
+// whole file.
+bool Logfile::skippedLinesBefore(time_t since) {
+    std::lock_guard<std::mutex> lg(_lock);
+    return _snapshot && _snapshot->minTime() < since;
+}
+
+// The indexes of the entries count for the budget of the cache, too.
+void Logfile::updateStatistics(
+    const std::shared_ptr<const LogfileEntries> &entries) {
+    std::lock_guard<std::mutex> lg(_lock);
+    if (entries == _entries) {
+        updateStatistics();
+    }
+}
+
+// Only the Bloom filter of an archive is used, as long as it covers all the
+// classes needed.
+bool Logfile::mightMentionHost(const std::string &host_name,
+                               unsigned logclasses) {
+    std::lock_guard<std::mutex> lg(_lock);
+    return !_host_filter || (logclasses & ~_host_filter_classes) != 0 ||
+           _host_filter->mightContain(host_name);
 }
 
-uint64_t Logfile::makeKey(time_t t, size_t lineno) {
-    return (static_cast<uint64_t>(t) << 32) | static_cast<uint64_t>(lineno);
+// The filter must cover the whole file, so we take it only from the entries
+// of the whole time range.
+void Logfile::rememberHosts(
+    const std::shared_ptr<const LogfileEntries> &entries,
+    const BloomFilter &hosts) {
+    std::lock_guard<std::mutex> lg(_lock);
+    if (_watch || entries != _entries || _read_since != earliest ||
+        _read_until != latest || _read_pos != 0 ||
+        (_logclasses_read & ~_host_filter_classes) == 0) {
+        return;
+    }
+    _host_filter = std::make_unique<BloomFilter>(hosts);
+    _host_filter_classes = _logclasses_read;
 }
 
 void Logfile::updateReferences() {
@@ -239,9 +811,9 @@ void Logfile::updateReferences() {
     // active configuration world, then update all references
     if (_world != g_live_world) {
         unsigned num = 0;
-        for (auto &entry : _entries) {
-            num += entry.second->updateReferences(_mc);
-        }
+        mutableEntries().modifyEach([&](LogEntry &entry) {
+            num += entry.updateReferences(_mc, _logcache);
+        });
         Notice(logger()) << "updated " << num << " log cache references of "
                          << _path << " to new world.";
         _world = g_live_world;
@@ -249,4 +821,9 @@ void Logfile::updateReferences() {
 #endif
 }
 
+void Logfile::updateStatistics() {
+    _num_cached_messages = _entries->size();
+    _num_cached_bytes = _entries->bytes();
+}
+
 Logger *Logfile::logger() const { return _mc->loggerLivestatus(); }
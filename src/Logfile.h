@@ -26,15 +26,25 @@
 #define Logfile_h
 
 #include "config.h"  // IWYU pragma: keep
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <cstdio>
 #include <ctime>
-#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include "BloomFilter.h"
 #include "FileSystem.h"
+#include "LogTrigramIndex.h"
+#include "LogfileIndex.h"
 class LogCache;
 class LogEntry;
+class LogHostIndex;
+class LogfileEntries;
+class LogfileSnapshot;
 class Logger;
 class MonitoringCore;
 class Query;
@@ -43,27 +53,67 @@ class Query;
 class World;
 #endif
 
-// key is time_t . lineno
-using logfile_entries_t = std::map<uint64_t, std::unique_ptr<LogEntry>>;
-
 class Logfile {
 public:
     Logfile(MonitoringCore *mc, LogCache *logcache, fs::path path, bool watch);
+    ~Logfile();
     [[nodiscard]] fs::path path() const { return _path; }
-
-    // for tricky protocol between LogCache::logLineHasBeenAdded and this class
-    void flush();
     [[nodiscard]] time_t since() const { return _since; }
-    [[nodiscard]] unsigned classesRead() const { return _logclasses_read; }
-    [[nodiscard]] size_t size() const { return _entries.size(); }
-    long freeMessages(unsigned logclasses);
+    [[nodiscard]] bool isWatched() const { return _watch; }
+
+    // Statistics for the eviction in the LogCache, readable without the lock.
+    // The time of the last use is a tick of the LogCache.
+    [[nodiscard]] size_t numCachedMessages() const {
+        return _num_cached_messages;
+    }
+    [[nodiscard]] size_t numCachedBytes() const { return _num_cached_bytes; }
+    [[nodiscard]] unsigned long hits() const { return _hits; }
+    [[nodiscard]] unsigned long misses() const { return _misses; }
+    [[nodiscard]] unsigned long lastUse() const { return _last_use; }
+
+    // for tricky protocol between LogCache::logLinesHaveBeenAdded and this
+    // class: Both return the number of freed messages, logfiles which are
+    // currently being loaded are left alone.
+    size_t flush();
+    size_t freeMessages(unsigned logclasses);
+    // Archives with a snapshot only: Frees the older half of the time range
+    // we have read, the snapshot lets us read it again cheaply.
+    size_t freeOlderHalf();
+
+    // for LogCache::update: Takes over the messages of the previous current
+    // logfile after it has been rotated to the archive file we represent.
+    void takeOver(Logfile &previous);
+
+    // for TableStateHistory. The returned entries are an immutable snapshot,
+    // they stay valid even when the logfile is flushed or loaded further.
+    std::shared_ptr<const LogfileEntries> getEntriesFor(unsigned logclasses);
 
-    // for TableStateHistory
-    const logfile_entries_t *getEntriesFor(unsigned logclasses);
+    // for the StateHistoryCache: Like getEntriesFor(), but an archive whose
+    // entries are not cached completely is read without caching anything, so
+    // reading through all of the log doesn't evict what queries have loaded.
+    std::shared_ptr<const LogfileEntries> readEntriesFor(unsigned logclasses);
 
-    // for TableLog::answerQuery
-    bool answerQueryReverse(Query *query, time_t since, time_t until,
-                            unsigned logclasses);
+    // for LogCache::update: Writes the index and the snapshot of an archive
+    // which doesn't have them yet, e.g. right after a log rotation.
+    void writeSidecars();
+
+    // for LogCache::prefetch: Loads the entries a query will need soon.
+    void prefetch(unsigned logclasses, time_t since);
+
+    // for TableLog::answerQuery: False if the logfile has no entries of the
+    // given classes for the host, as far as we know without loading it.
+    bool mightMentionHost(const std::string &host_name, unsigned logclasses);
+
+    // for TableLog::answerQuery, the fields of the entries are only parsed
+    // when the query needs them. Queries restricted to a host, and maybe a
+    // service, only visit its entries, and skip archives not mentioning the
+    // host at all. Searches for the given trigrams skip the entries which
+    // can't contain them.
+    bool answerQueryReverse(
+        Query *query, time_t since, time_t until, unsigned logclasses,
+        bool parse_fields, const std::optional<std::string> &host_name,
+        const std::optional<std::string> &service_description,
+        const LogTrigramIndex::Trigrams &trigrams);
 
 private:
     MonitoringCore *const _mc;
@@ -71,19 +121,68 @@ private:
     const fs::path _path;
     const time_t _since;  // time of first entry
     const bool _watch;    // true only for current logfile
-    fpos_t _read_pos;     // read until this position
-    size_t _lineno;       // read until this line
-    logfile_entries_t _entries;
+
+    // The mutex protects all fields below. Entries are copied on write when
+    // a query still holds a snapshot of them.
+    std::mutex _lock;
+    // current logfile: read until this position, archives: Only non-zero
+    // after takeOver(), until the rest of the file has been read.
+    off_t _read_pos;
+    size_t _lineno;    // read until this line
+    // Current logfile only: The inode we have read, and the next line of the
+    // LogCache's tail we have not looked at yet.
+    ino_t _inode;
+    uint64_t _tail_seq;
+    std::shared_ptr<LogfileEntries> _entries;
+    // Archives only: The sidecar index and snapshot, if any, and the time
+    // range we have read the classes in _logclasses_read for. Without a
+    // snapshot, we always read the whole file.
+    std::unique_ptr<LogfileIndex> _index;
+    std::unique_ptr<LogfileSnapshot> _snapshot;
+    bool _sidecars_read;
+    time_t _read_since;
+    time_t _read_until;
 #ifdef CMC
     World *_world;  // CMC: world our references point into
 #endif
     unsigned _logclasses_read;  // only these types have been read
+    // Archives only: The hosts of the classes in _host_filter_classes, kept
+    // when the entries are flushed.
+    std::unique_ptr<BloomFilter> _host_filter;
+    unsigned _host_filter_classes;
+    // Archives only: False for a logfile reading an archive besides the one
+    // in the LogCache, only the latter may write its sidecars.
+    bool _writes_sidecars;
+
+    std::atomic<size_t> _num_cached_messages;
+    std::atomic<size_t> _num_cached_bytes;
+    std::atomic<unsigned long> _hits;
+    std::atomic<unsigned long> _misses;
+    std::atomic<unsigned long> _last_use;
 
-    void load(unsigned logclasses);
-    void loadRange(FILE *file, unsigned missing_types, unsigned logclasses);
-    bool processLogLine(size_t lineno, std::string line, unsigned logclasses);
-    uint64_t makeKey(time_t t, size_t lineno);
+    std::shared_ptr<const LogfileEntries> getEntriesFor(unsigned logclasses,
+                                                           time_t since,
+                                                           time_t until);
+    size_t load(unsigned logclasses, time_t since, time_t until);
+    size_t loadArchive(unsigned logclasses, time_t since, time_t until);
+    void readSidecars();
+    size_t loadRange(int fd, off_t &offset, off_t end, unsigned missing_types,
+                     LogfileIndex *index, LogfileSnapshot *snapshot);
+    size_t loadSnapshotRange(int fd, off_t &offset, off_t end,
+                             unsigned missing_types, time_t since,
+                             time_t until);
+    bool loadFromTail(size_t &added);
+    bool addLine(std::string_view line, off_t line_offset, unsigned logclasses,
+                 LogfileIndex *index, LogfileSnapshot *snapshot, size_t &added);
+    void sortEntries();
+    bool addEntry(const LogEntry &entry, unsigned logclasses);
+    bool skippedLinesBefore(time_t since);
+    LogfileEntries &mutableEntries();
+    void rememberHosts(const std::shared_ptr<const LogfileEntries> &entries,
+                       const BloomFilter &hosts);
     void updateReferences();
+    void updateStatistics();
+    void updateStatistics(const std::shared_ptr<const LogfileEntries> &entries);
     [[nodiscard]] Logger *logger() const;
 };
 
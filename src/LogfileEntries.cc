@@ -0,0 +1,228 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogfileEntries.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include "LogHostIndex.h"
+#include "LogTrigramIndex.h"
+
+namespace {
+// Small logfiles or few cached classes shouldn't waste much memory, but the
+// big ones shouldn't need too many chunks.
+constexpr size_t min_chunk_size = 64 * 1024;
+constexpr size_t max_chunk_size = 1024 * 1024;
+
+bool less(const LogEntry &a, const LogEntry &b) {
+    return std::tie(a._time, a._lineno) < std::tie(b._time, b._lineno);
+}
+
+bool equal(const LogEntry &a, const LogEntry &b) {
+    return a._time == b._time && a._lineno == b._lineno;
+}
+}  // namespace
+
+LogfileEntries::LogfileEntries()
+    : _size(0)
+    , _num_sorted(0)
+    , _chunk_bytes(0)
+    , _chunk_size(0)
+    , _chunk_used(0) {}
+
+// The indexes of the original might be built concurrently.
+LogfileEntries::LogfileEntries(const LogfileEntries &other)
+    : _segments(other._segments)
+    , _size(other._size)
+    , _num_sorted(other._num_sorted)
+    , _chunks(other._chunks)
+    , _chunk_bytes(other._chunk_bytes)
+    , _chunk_size(other._chunk_size)
+    , _chunk_used(other._chunk_used)
+    , _host_index(std::atomic_load(&other._host_index))
+    , _trigram_index(std::atomic_load(&other._trigram_index)) {}
+
+size_t LogfileEntries::bytes() const {
+    auto host_index = std::atomic_load(&_host_index);
+    auto trigram_index = std::atomic_load(&_trigram_index);
+    return _segments.size() * segment_size * sizeof(LogEntry) + _chunk_bytes +
+           (host_index ? host_index->bytes() : 0) +
+           (trigram_index ? trigram_index->bytes() : 0);
+}
+
+LogfileEntries::const_iterator LogfileEntries::upperBound(time_t t) const {
+    return std::upper_bound(
+        begin(), end(), t,
+        [](time_t time, const LogEntry &entry) { return time < entry._time; });
+}
+
+void LogfileEntries::add(LogEntry entry) {
+    entry.moveLineTo(allocate(entry.lineLength()));
+    append(std::move(entry));
+    _host_index.reset();
+    _trigram_index.reset();
+}
+
+void LogfileEntries::append(LogEntry entry) {
+    if (_size % segment_size == 0) {
+        _segments.push_back(std::make_shared<Segment>());
+        _segments.back()->reserve(segment_size);
+    } else if (_segments.back().use_count() > 1) {
+        // Nobody can get a new reference to the segment while we modify it,
+        // we are the only owner of this copy.
+        _segments.back() = std::make_shared<Segment>(*_segments.back());
+        _segments.back()->reserve(segment_size);
+    }
+    _segments.back()->push_back(std::move(entry));
+    _size++;
+}
+
+// Moves the entries out of the given segment and the ones after it, copying
+// them if they are shared.
+std::vector<LogEntry> LogfileEntries::takeFrom(size_t segment) {
+    std::vector<LogEntry> result;
+    result.reserve(_size - segment * segment_size);
+    for (size_t i = segment; i < _segments.size(); ++i) {
+        auto &entries = *_segments[i];
+        if (_segments[i].use_count() == 1) {
+            std::move(entries.begin(), entries.end(),
+                      std::back_inserter(result));
+        } else {
+            result.insert(result.end(), entries.begin(), entries.end());
+        }
+    }
+    _segments.resize(segment);
+    _size = segment * segment_size;
+    return result;
+}
+
+size_t LogfileEntries::sort() {
+    // Lines are mostly added in the order of their timestamps, so usually
+    // there is nothing to do.
+    size_t first = _num_sorted == 0 ? 0 : _num_sorted - 1;
+    if (std::adjacent_find(begin() + first, end(),
+                           [](const LogEntry &a, const LogEntry &b) {
+                               return !less(a, b);
+                           }) == end()) {
+        _num_sorted = _size;
+        return 0;
+    }
+    // Only the segments from the unsorted entries on are rebuilt.
+    auto entries = takeFrom(first / segment_size);
+    auto sorted = static_cast<ptrdiff_t>(_num_sorted - _size);
+    if (!std::is_sorted(entries.begin() + sorted, entries.end(), less)) {
+        std::stable_sort(entries.begin() + sorted, entries.end(), less);
+    }
+    if (_size != 0 && entries.begin() + sorted != entries.end() &&
+        less(entries[sorted], *(end() - 1))) {
+        // older lines, e.g. when we extend the range read from an archive
+        auto newer = std::move(entries);
+        entries = takeFrom(0);
+        sorted += static_cast<ptrdiff_t>(entries.size());
+        entries.insert(entries.end(), std::make_move_iterator(newer.begin()),
+                       std::make_move_iterator(newer.end()));
+    }
+    auto middle = entries.begin() + sorted;
+    if (middle != entries.begin() && middle != entries.end() &&
+        less(*middle, *(middle - 1))) {
+        std::inplace_merge(entries.begin(), middle, entries.end(), less);
+    }
+    auto last = std::unique(entries.begin(), entries.end(), equal);
+    auto dropped = static_cast<size_t>(entries.end() - last);
+    entries.erase(last, entries.end());
+    for (auto &entry : entries) {
+        append(std::move(entry));
+    }
+    _num_sorted = _size;
+    return dropped;
+}
+
+// Concurrent queries might build the index twice, but that is harmless.
+std::shared_ptr<const LogHostIndex> LogfileEntries::hostIndex(
+    MonitoringCore *mc, LogCache *log_cache) const {
+    auto index = std::atomic_load(&_host_index);
+    if (!index) {
+        index = std::make_shared<LogHostIndex>(*this, mc, log_cache);
+        std::atomic_store(&_host_index, index);
+    }
+    return index;
+}
+
+std::shared_ptr<const LogTrigramIndex> LogfileEntries::trigramIndex() const {
+    auto index = std::atomic_load(&_trigram_index);
+    if (!index) {
+        index = std::make_shared<LogTrigramIndex>(*this);
+        std::atomic_store(&_trigram_index, index);
+    }
+    return index;
+}
+
+void LogfileEntries::modifyEach(const std::function<void(LogEntry &)> &f) {
+    for (auto &segment : _segments) {
+        if (segment.use_count() > 1) {
+            segment = std::make_shared<Segment>(*segment);
+            segment->reserve(segment_size);
+        }
+        for (auto &entry : *segment) {
+            f(entry);
+        }
+    }
+}
+
+std::shared_ptr<LogfileEntries> LogfileEntries::without(
+    unsigned logclasses) const {
+    auto result = std::make_shared<LogfileEntries>();
+    for (const auto &entry : *this) {
+        if (((1U << static_cast<int>(entry._logclass)) & logclasses) == 0U) {
+            result->add(entry);
+        }
+    }
+    result->_num_sorted = result->_size;
+    return result;
+}
+
+std::shared_ptr<LogfileEntries> LogfileEntries::since(time_t t) const {
+    auto result = std::make_shared<LogfileEntries>();
+    for (auto it = upperBound(t - 1); it != end(); ++it) {
+        result->add(*it);
+    }
+    result->_num_sorted = result->_size;
+    return result;
+}
+
+char *LogfileEntries::allocate(size_t size) {
+    if (_chunks.empty() || _chunk_used + size > _chunk_size) {
+        _chunk_size = std::max(
+            size, _chunks.empty() ? min_chunk_size
+                                  : std::min(2 * _chunk_size, max_chunk_size));
+        _chunks.emplace_back(new char[_chunk_size]);
+        _chunk_bytes += _chunk_size;
+        _chunk_used = 0;
+    }
+    char *result = _chunks.back().get() + _chunk_used;
+    _chunk_used += size;
+    return result;
+}
@@ -0,0 +1,196 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogfileEntries_h
+#define LogfileEntries_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "LogEntry.h"
+class LogCache;
+class LogHostIndex;
+class LogTrigramIndex;
+class MonitoringCore;
+
+/// The cached entries of a logfile, sorted by time and line number. The
+/// entries reference their lines, which are kept in big chunks of memory owned
+/// by this class instead of a few heap blocks per entry. The entries
+/// themselves are kept in segments of a fixed size. Copies share the chunks
+/// and the segments: Only the unused end of the last chunk is ever written to,
+/// and only the last segment, which is copied first if it is shared. So a copy
+/// can be extended while the original is still being read, copying at most one
+/// segment.
+class LogfileEntries {
+    static constexpr size_t segment_bits = 10;
+    static constexpr size_t segment_size = size_t{1} << segment_bits;
+    using Segment = std::vector<LogEntry>;
+    using Segments = std::vector<std::shared_ptr<Segment>>;
+
+public:
+    // A random access iterator over the entries of all segments.
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = LogEntry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const LogEntry *;
+        using reference = const LogEntry &;
+
+        const_iterator() : _segments(nullptr), _pos(0) {}
+        const_iterator(const Segments *segments, size_t pos)
+            : _segments(segments), _pos(pos) {}
+
+        reference operator*() const {
+            return (*(*_segments)[_pos >> segment_bits])[_pos &
+                                                         (segment_size - 1)];
+        }
+        pointer operator->() const { return &**this; }
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        const_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto result = *this;
+            ++_pos;
+            return result;
+        }
+        const_iterator &operator--() {
+            --_pos;
+            return *this;
+        }
+        const_iterator operator--(int) {
+            auto result = *this;
+            --_pos;
+            return result;
+        }
+        const_iterator &operator+=(difference_type n) {
+            _pos += n;
+            return *this;
+        }
+        const_iterator &operator-=(difference_type n) {
+            _pos -= n;
+            return *this;
+        }
+        const_iterator operator+(difference_type n) const {
+            return {_segments, _pos + n};
+        }
+        friend const_iterator operator+(difference_type n,
+                                        const const_iterator &it) {
+            return it + n;
+        }
+        const_iterator operator-(difference_type n) const {
+            return {_segments, _pos - n};
+        }
+        difference_type operator-(const const_iterator &other) const {
+            return static_cast<difference_type>(_pos) -
+                   static_cast<difference_type>(other._pos);
+        }
+        bool operator==(const const_iterator &other) const {
+            return _pos == other._pos;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return _pos != other._pos;
+        }
+        bool operator<(const const_iterator &other) const {
+            return _pos < other._pos;
+        }
+        bool operator>(const const_iterator &other) const {
+            return _pos > other._pos;
+        }
+        bool operator<=(const const_iterator &other) const {
+            return _pos <= other._pos;
+        }
+        bool operator>=(const const_iterator &other) const {
+            return _pos >= other._pos;
+        }
+
+    private:
+        const Segments *_segments;
+        size_t _pos;
+    };
+
+    LogfileEntries();
+    // The indexes are shared, too, until the copy is modified.
+    LogfileEntries(const LogfileEntries &other);
+    LogfileEntries &operator=(const LogfileEntries &) = delete;
+
+    [[nodiscard]] bool empty() const { return _size == 0; }
+    [[nodiscard]] size_t size() const { return _size; }
+    // the memory used, including the chunks and segments shared with other
+    // copies and the indexes
+    [[nodiscard]] size_t bytes() const;
+    [[nodiscard]] const_iterator begin() const { return {&_segments, 0}; }
+    [[nodiscard]] const_iterator end() const { return {&_segments, _size}; }
+
+    // The first entry later than the given time.
+    [[nodiscard]] const_iterator upperBound(time_t t) const;
+
+    // Adds an entry with a copy of its line. Entries can be added in any
+    // order, but sort() has to be called afterwards.
+    void add(LogEntry entry);
+    // Returns the number of dropped duplicates, which should never happen:
+    // The line numbers are unique.
+    size_t sort();
+    // Calls f for all entries, copying the segments shared with other copies
+    // first.
+    void modifyEach(const std::function<void(LogEntry &)> &f);
+
+    // A copy without the entries of the given classes, sharing no chunks with
+    // this one, so the memory of the dropped lines is really freed.
+    [[nodiscard]] std::shared_ptr<LogfileEntries> without(
+        unsigned logclasses) const;
+    // Dito without the entries before the given time.
+    [[nodiscard]] std::shared_ptr<LogfileEntries> since(time_t t) const;
+
+    // The index of the entries by host and service, built on first use. This
+    // can be called concurrently, the index is dropped when entries are added.
+    std::shared_ptr<const LogHostIndex> hostIndex(MonitoringCore *mc,
+                                                  LogCache *log_cache) const;
+    // Dito for the full-text index of the messages.
+    std::shared_ptr<const LogTrigramIndex> trigramIndex() const;
+
+private:
+    Segments _segments;
+    size_t _size;
+    size_t _num_sorted;  // the entries before this index are sorted
+    std::vector<std::shared_ptr<char[]>> _chunks;
+    size_t _chunk_bytes;  // sum of the chunk sizes
+    size_t _chunk_size;  // size of the last chunk
+    size_t _chunk_used;  // bytes used in the last chunk
+    mutable std::shared_ptr<const LogHostIndex> _host_index;
+    mutable std::shared_ptr<const LogTrigramIndex> _trigram_index;
+
+    char *allocate(size_t size);
+    void append(LogEntry entry);
+    [[nodiscard]] std::vector<LogEntry> takeFrom(size_t segment);
+};
+
+#endif  // LogfileEntries_h
@@ -0,0 +1,190 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogfileIndex.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include "Logger.h"
+#include "StringUtils.h"
+
+namespace {
+const std::string index_suffix = ".idx";
+const std::string temporary_suffix = ".tmp";
+// made unique by mkstemps(), before the suffixes of a temporary file
+const std::string unique_part = ".XXXXXX";
+const std::string index_magic = "livestatus-logfile-index-1";
+}  // namespace
+
+// static
+fs::path LogfileIndex::indexPath(const fs::path &logfile) {
+    return logfile.string() + index_suffix;
+}
+
+// static
+bool LogfileIndex::isIndexFile(const fs::path &path) {
+    // Also catches temporary files left behind by a crash during write().
+    auto name = path.filename().string();
+    return mk::ends_with(name, index_suffix) ||
+           mk::ends_with(name, index_suffix + temporary_suffix);
+}
+
+// static
+fs::path LogfileIndex::logfileOf(const fs::path &path) {
+    auto name = path.string();
+    size_t length = index_suffix.size();
+    if (mk::ends_with(name, temporary_suffix)) {
+        length += temporary_suffix.size() + unique_part.size();
+    }
+    return name.substr(0, name.size() - std::min(length, name.size()));
+}
+
+// static
+bool LogfileIndex::statLogfile(const fs::path &logfile, off_t &size,
+                               time_t &mtime) {
+    struct stat st;
+    if (stat(logfile.c_str(), &st) == -1) {
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+// static
+std::unique_ptr<LogfileIndex> LogfileIndex::read(const fs::path &logfile,
+                                                 Logger *logger) {
+    off_t size;
+    time_t mtime;
+    if (!statLogfile(logfile, size, mtime)) {
+        return nullptr;
+    }
+    std::ifstream is(indexPath(logfile));
+    if (!is) {
+        return nullptr;
+    }
+    auto index = std::make_unique<LogfileIndex>();
+    std::string magic;
+    size_t num_checkpoints = 0;
+    is >> magic >> index->_size >> index->_mtime >> index->_max_time;
+    for (auto &count : index->_counts) {
+        is >> count;
+    }
+    is >> num_checkpoints;
+    if (!is || magic != index_magic) {
+        Informational(logger) << "ignoring invalid index of " << logfile;
+        return nullptr;
+    }
+    if (index->_size != size || index->_mtime != mtime) {
+        Debug(logger) << "ignoring outdated index of " << logfile;
+        return nullptr;
+    }
+    index->_checkpoints.reserve(num_checkpoints);
+    for (size_t i = 0; i < num_checkpoints; ++i) {
+        Checkpoint cp{};
+        is >> cp._offset >> cp._lineno >> cp._max_time;
+        index->_checkpoints.push_back(cp);
+    }
+    if (!is) {
+        Informational(logger) << "ignoring truncated index of " << logfile;
+        return nullptr;
+    }
+    return index;
+}
+
+void LogfileIndex::addLine(off_t offset, size_t lineno, time_t time,
+                           int logclass) {
+    if (lineno % checkpoint_interval == 0) {
+        _checkpoints.push_back({offset, lineno, _max_time});
+    }
+    _max_time = std::max(_max_time, time);
+    if (logclass >= 0 && static_cast<size_t>(logclass) < num_classes) {
+        _counts[logclass]++;
+    }
+}
+
+void LogfileIndex::write(const fs::path &logfile, Logger *logger) {
+    if (!statLogfile(logfile, _size, _mtime)) {
+        return;
+    }
+    // Write to a temporary file of our own first, so neither readers nor
+    // other writers ever see a partial index.
+    auto path = indexPath(logfile);
+    std::string tmp_path =
+        logfile.string() + unique_part + index_suffix + temporary_suffix;
+    int fd = mkstemps(&tmp_path[0], static_cast<int>(index_suffix.size() +
+                                                     temporary_suffix.size()));
+    if (fd == -1) {
+        generic_error ge("cannot create " + tmp_path);
+        Debug(logger) << ge;
+        return;
+    }
+    close(fd);
+    {
+        std::ofstream os(tmp_path);
+        os << index_magic << "\n"
+           << _size << " " << _mtime << " " << _max_time << "\n";
+        for (auto count : _counts) {
+            os << count << " ";
+        }
+        os << "\n" << _checkpoints.size() << "\n";
+        for (const auto &cp : _checkpoints) {
+            os << cp._offset << " " << cp._lineno << " " << cp._max_time
+               << "\n";
+        }
+        os.close();
+        if (!os) {
+            Debug(logger) << "cannot write index of " << logfile;
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) == -1) {
+        generic_error ge("cannot rename " + tmp_path);
+        Debug(logger) << ge;
+        std::remove(tmp_path.c_str());
+    }
+}
+
+unsigned LogfileIndex::classes() const {
+    unsigned result = 0;
+    for (size_t i = 0; i < num_classes; ++i) {
+        if (_counts[i] != 0) {
+            result |= 1U << i;
+        }
+    }
+    return result;
+}
+
+LogfileIndex::Checkpoint LogfileIndex::startFor(time_t since) const {
+    // The maximum times are monotonic, so we can do a binary search.
+    auto it = std::partition_point(
+        _checkpoints.begin(), _checkpoints.end(),
+        [since](const Checkpoint &cp) { return cp._max_time < since; });
+    return it == _checkpoints.begin() ? Checkpoint{0, 0, 0} : *--it;
+}
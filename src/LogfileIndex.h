@@ -0,0 +1,83 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogfileIndex_h
+#define LogfileIndex_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <sys/types.h>
+#include <array>
+#include <cstddef>
+#include <ctime>
+#include <memory>
+#include <vector>
+#include "FileSystem.h"
+class Logger;
+
+/// A sparse index of an archived logfile: Every few lines a checkpoint with
+/// the byte offset and line number of a line start, plus the number of lines
+/// of each log class. It is stored in a sidecar file next to the logfile and
+/// is only valid as long as the logfile's size and mtime don't change.
+class LogfileIndex {
+public:
+    struct Checkpoint {
+        off_t _offset;      // start of a line
+        size_t _lineno;     // number of lines before _offset
+        time_t _max_time;   // latest timestamp of all lines before _offset
+    };
+
+    static constexpr size_t checkpoint_interval = 1000;
+    static constexpr size_t num_classes = 9;
+
+    // Returns the index of the given logfile, nullptr if there is no valid
+    // one.
+    static std::unique_ptr<LogfileIndex> read(const fs::path &logfile,
+                                              Logger *logger);
+    static bool isIndexFile(const fs::path &path);
+    // The logfile of a sidecar or of one of its temporary files.
+    static fs::path logfileOf(const fs::path &path);
+
+    // For building the index while reading the whole logfile, line by line.
+    void addLine(off_t offset, size_t lineno, time_t time, int logclass);
+    void write(const fs::path &logfile, Logger *logger);
+
+    // The classes for which the logfile contains at least one line.
+    [[nodiscard]] unsigned classes() const;
+
+    // The latest checkpoint before which all lines are older than since.
+    [[nodiscard]] Checkpoint startFor(time_t since) const;
+
+private:
+    off_t _size{0};
+    time_t _mtime{0};
+    time_t _max_time{0};
+    std::array<size_t, num_classes> _counts{};
+    std::vector<Checkpoint> _checkpoints;
+
+    static fs::path indexPath(const fs::path &logfile);
+    static bool statLogfile(const fs::path &logfile, off_t &size,
+                            time_t &mtime);
+};
+
+#endif  // LogfileIndex_h
@@ -0,0 +1,326 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "LogfileSnapshot.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <string>
+#include "Logger.h"
+#include "StringUtils.h"
+
+namespace {
+const std::string snapshot_suffix = ".snap";
+const std::string temporary_suffix = ".tmp";
+// made unique by mkstemps(), before the suffixes of a temporary file
+const std::string unique_part = ".XXXXXX";
+constexpr char snapshot_magic[16] = "livestatus-snp4";
+
+struct Header {
+    char _magic[16];
+    uint64_t _definitions;  // LogEntry::definitionsHash()
+    uint64_t _size;
+    int64_t _mtime;
+    uint64_t _inode;
+    uint64_t _num_lines;
+};
+
+size_t numBlocks(size_t num_lines) {
+    return (num_lines + LogfileSnapshot::block_size - 1) /
+           LogfileSnapshot::block_size;
+}
+
+// The columns after the header and the block table, all naturally aligned.
+constexpr size_t bytes_per_line = 3 * sizeof(uint32_t) + sizeof(int16_t) +
+                                  2 * sizeof(uint8_t);
+
+bool statLogfile(const fs::path &logfile, Header &header) {
+    struct stat st;
+    if (stat(logfile.c_str(), &st) == -1) {
+        return false;
+    }
+    header._size = st.st_size;
+    header._mtime = st.st_mtime;
+    header._inode = st.st_ino;
+    return true;
+}
+
+template <typename T>
+void writeColumn(std::ostream &os, const std::vector<T> &column) {
+    os.write(reinterpret_cast<const char *>(column.data()),
+             static_cast<std::streamsize>(column.size() * sizeof(T)));
+}
+}  // namespace
+
+LogfileSnapshot::LogfileSnapshot()
+    : _file_size(0)
+    , _num_lines(0)
+    , _min_time(0)
+    , _max_time(0)
+    , _blocks(nullptr)
+    , _times(nullptr)
+    , _lengths(nullptr)
+    , _options(nullptr)
+    , _defs(nullptr)
+    , _logclasses(nullptr)
+    , _types(nullptr)
+    , _map(MAP_FAILED)
+    , _map_length(0) {}
+
+LogfileSnapshot::~LogfileSnapshot() {
+    if (_map != MAP_FAILED) {
+        munmap(_map, _map_length);
+    }
+}
+
+// static
+fs::path LogfileSnapshot::snapshotPath(const fs::path &logfile) {
+    return logfile.string() + snapshot_suffix;
+}
+
+// static
+bool LogfileSnapshot::isSnapshotFile(const fs::path &path) {
+    // Also catches temporary files left behind by a crash during write().
+    auto name = path.filename().string();
+    return mk::ends_with(name, snapshot_suffix) ||
+           mk::ends_with(name, snapshot_suffix + temporary_suffix);
+}
+
+// static
+fs::path LogfileSnapshot::logfileOf(const fs::path &path) {
+    auto name = path.string();
+    size_t length = snapshot_suffix.size();
+    if (mk::ends_with(name, temporary_suffix)) {
+        length += temporary_suffix.size() + unique_part.size();
+    }
+    return name.substr(0, name.size() - std::min(length, name.size()));
+}
+
+// static
+std::unique_ptr<LogfileSnapshot> LogfileSnapshot::read(
+    const fs::path &logfile, Logger *logger) {
+    Header expected{};
+    if (!statLogfile(logfile, expected)) {
+        return nullptr;
+    }
+    auto path = snapshotPath(logfile);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    auto snapshot = std::make_unique<LogfileSnapshot>();
+    if (fstat(fd, &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+        snapshot->_map_length = st.st_size;
+        snapshot->_map = mmap(nullptr, snapshot->_map_length, PROT_READ,
+                              MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (snapshot->_map == MAP_FAILED) {
+        Informational(logger) << "ignoring invalid snapshot of " << logfile;
+        return nullptr;
+    }
+
+    const auto *header = static_cast<const Header *>(snapshot->_map);
+    size_t n = header->_num_lines;
+    if (memcmp(header->_magic, snapshot_magic, sizeof(snapshot_magic)) != 0 ||
+        snapshot->_map_length != sizeof(Header) + numBlocks(n) * sizeof(Block) +
+                                     n * bytes_per_line) {
+        Informational(logger) << "ignoring invalid snapshot of " << logfile;
+        return nullptr;
+    }
+    if (header->_definitions != LogEntry::definitionsHash()) {
+        Debug(logger) << "ignoring snapshot of " << logfile
+                      << " for other log definitions";
+        return nullptr;
+    }
+    if (header->_size != expected._size || header->_mtime != expected._mtime ||
+        header->_inode != expected._inode) {
+        Debug(logger) << "ignoring outdated snapshot of " << logfile;
+        return nullptr;
+    }
+    snapshot->_file_size = static_cast<off_t>(header->_size);
+    snapshot->_num_lines = n;
+    snapshot->_blocks = reinterpret_cast<const Block *>(header + 1);
+    snapshot->_times =
+        reinterpret_cast<const uint32_t *>(snapshot->_blocks + numBlocks(n));
+    snapshot->_lengths = snapshot->_times + n;
+    snapshot->_options = snapshot->_lengths + n;
+    snapshot->_defs = reinterpret_cast<const int16_t *>(snapshot->_options + n);
+    snapshot->_logclasses =
+        reinterpret_cast<const uint8_t *>(snapshot->_defs + n);
+    snapshot->_types = snapshot->_logclasses + n;
+    if (!snapshot->isConsistent()) {
+        Informational(logger) << "ignoring corrupt snapshot of " << logfile;
+        return nullptr;
+    }
+    uint32_t min_time = std::numeric_limits<uint32_t>::max();
+    uint32_t max_time = 0;
+    for (size_t b = 0; b < numBlocks(n); ++b) {
+        if (snapshot->_blocks[b]._classes != 0) {
+            min_time = std::min(min_time, snapshot->_blocks[b]._min_time);
+            max_time = std::max(max_time, snapshot->_blocks[b]._max_time);
+        }
+    }
+    snapshot->_min_time = min_time;
+    snapshot->_max_time = max_time;
+    return snapshot;
+}
+
+// The blocks must start where the lines before them end, and all lines must
+// be within the logfile, so nothing is read outside of its mapping.
+bool LogfileSnapshot::isConsistent() const {
+    uint64_t offset = 0;
+    for (size_t i = 0; i < _num_lines; ++i) {
+        if (i % block_size == 0 && _blocks[i / block_size]._offset != offset) {
+            return false;
+        }
+        if (!LogEntry::isPlausible(summary(i))) {
+            return false;
+        }
+        offset += static_cast<uint64_t>(_lengths[i]) + 1;
+    }
+    // The last line might lack its newline.
+    return offset <= static_cast<uint64_t>(_file_size) + 1;
+}
+
+void LogfileSnapshot::addLine(off_t offset, const LogEntry &entry) {
+    _built.emplace_back(offset, entry.summary());
+}
+
+void LogfileSnapshot::write(const fs::path &logfile, Logger *logger) {
+    Header header{};
+    if (!statLogfile(logfile, header)) {
+        return;
+    }
+    memcpy(header._magic, snapshot_magic, sizeof(snapshot_magic));
+    header._definitions = LogEntry::definitionsHash();
+    header._num_lines = _built.size();
+
+    std::vector<Block> blocks(
+        numBlocks(_built.size()),
+        Block{0, 0, std::numeric_limits<uint32_t>::max(), 0, 0});
+    std::vector<uint32_t> times;
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> options;
+    std::vector<int16_t> defs;
+    std::vector<uint8_t> logclasses;
+    std::vector<uint8_t> types;
+    for (size_t i = 0; i < _built.size(); ++i) {
+        const auto &[offset, summary] = _built[i];
+        Block &block = blocks[i / block_size];
+        if (i % block_size == 0) {
+            block._offset = static_cast<uint64_t>(offset);
+        }
+        if (summary._logclass != LogEntry::invalid_class) {
+            block._classes |= 1U << summary._logclass;
+            block._min_time = std::min(block._min_time, summary._time);
+            block._max_time = std::max(block._max_time, summary._time);
+        }
+        times.push_back(summary._time);
+        lengths.push_back(summary._length);
+        options.push_back(summary._options);
+        defs.push_back(summary._def);
+        logclasses.push_back(summary._logclass);
+        types.push_back(summary._type);
+    }
+
+    // Write to a temporary file of our own first, so neither readers nor
+    // other writers ever see a partial snapshot.
+    auto path = snapshotPath(logfile);
+    std::string tmp_path =
+        logfile.string() + unique_part + snapshot_suffix + temporary_suffix;
+    int fd = mkstemps(&tmp_path[0],
+                      static_cast<int>(snapshot_suffix.size() +
+                                       temporary_suffix.size()));
+    if (fd == -1) {
+        generic_error ge("cannot create " + tmp_path);
+        Debug(logger) << ge;
+        return;
+    }
+    close(fd);
+    {
+        std::ofstream os(tmp_path, std::ios::binary);
+        os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        writeColumn(os, blocks);
+        writeColumn(os, times);
+        writeColumn(os, lengths);
+        writeColumn(os, options);
+        writeColumn(os, defs);
+        writeColumn(os, logclasses);
+        writeColumn(os, types);
+        os.close();
+        if (!os) {
+            Debug(logger) << "cannot write snapshot of " << logfile;
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) == -1) {
+        generic_error ge("cannot rename " + tmp_path);
+        Debug(logger) << ge;
+        std::remove(tmp_path.c_str());
+    }
+}
+
+size_t LogfileSnapshot::lineAt(off_t offset) const {
+    // the first block starting behind the offset
+    size_t b = std::partition_point(_blocks, _blocks + numBlocks(_num_lines),
+                                    [offset](const Block &block) {
+                                        return static_cast<off_t>(
+                                                   block._offset) <= offset;
+                                    }) -
+               _blocks;
+    if (b == 0) {
+        return 0;
+    }
+    size_t i = (b - 1) * block_size;
+    size_t end = std::min(_num_lines, b * block_size);
+    for (auto pos = static_cast<off_t>(_blocks[b - 1]._offset);
+         i < end && pos < offset; ++i) {
+        pos += static_cast<off_t>(_lengths[i]) + 1;
+    }
+    return i;
+}
+
+off_t LogfileSnapshot::offsetOf(size_t i) const {
+    if (i >= _num_lines) {
+        return _file_size;
+    }
+    size_t b = i / block_size;
+    auto offset = static_cast<off_t>(_blocks[b]._offset);
+    for (size_t j = b * block_size; j < i; ++j) {
+        offset += static_cast<off_t>(_lengths[j]) + 1;
+    }
+    return offset;
+}
@@ -0,0 +1,143 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef LogfileSnapshot_h
+#define LogfileSnapshot_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <sys/types.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "FileSystem.h"
+#include "LogEntry.h"
+class Logger;
+
+/// The parsed lines of an archived logfile in a columnar form, stored in a
+/// binary sidecar file next to the logfile: The lines are grouped into blocks,
+/// each with the offset of its first line, a mask of the classes in it and
+/// the time range of these lines, and the fields of the lines'
+/// LogEntry::Summary are stored column by column. The logfile can then be
+/// loaded without splitting and classifying each line, skipping whole blocks
+/// without any of the classes or times needed and touching only the columns
+/// and lines needed. The text of the lines stays in the
+/// logfile. The sidecar is mapped into memory, and it is only valid as long
+/// as the logfile's size, mtime and inode don't change.
+class LogfileSnapshot {
+public:
+    static constexpr size_t block_size = 1024;
+
+    // Returns the snapshot of the given logfile, nullptr if there is no valid
+    // one.
+    static std::unique_ptr<LogfileSnapshot> read(const fs::path &logfile,
+                                                 Logger *logger);
+    static bool isSnapshotFile(const fs::path &path);
+    // The logfile of a sidecar or of one of its temporary files.
+    static fs::path logfileOf(const fs::path &path);
+
+    LogfileSnapshot();
+    ~LogfileSnapshot();
+    LogfileSnapshot(const LogfileSnapshot &) = delete;
+    LogfileSnapshot &operator=(const LogfileSnapshot &) = delete;
+
+    // For building the snapshot while reading the whole logfile, line by
+    // line.
+    void addLine(off_t offset, const LogEntry &entry);
+    void write(const fs::path &logfile, Logger *logger);
+
+    [[nodiscard]] off_t fileSize() const { return _file_size; }
+    [[nodiscard]] size_t numLines() const { return _num_lines; }
+    // The time range of all lines with a class.
+    [[nodiscard]] time_t minTime() const { return _min_time; }
+    [[nodiscard]] time_t maxTime() const { return _max_time; }
+
+    // The number of the first line starting at or behind the given offset,
+    // and the offset of the line with the given number.
+    [[nodiscard]] size_t lineAt(off_t offset) const;
+    [[nodiscard]] off_t offsetOf(size_t i) const;
+
+    // Calls process(i, offset, summary) for the lines in [first, last) with
+    // one of the given classes and a time in [since, until].
+    template <typename Process>
+    void forEachLine(size_t first, size_t last, unsigned classes, time_t since,
+                     time_t until, Process process) const {
+        for (size_t b = first / block_size; b * block_size < last; ++b) {
+            const Block &block = _blocks[b];
+            if ((block._classes & classes) == 0 ||
+                static_cast<time_t>(block._max_time) < since ||
+                static_cast<time_t>(block._min_time) > until) {
+                continue;
+            }
+            auto offset = static_cast<off_t>(block._offset);
+            size_t end = std::min(last, (b + 1) * block_size);
+            for (size_t i = b * block_size; i < end; ++i) {
+                if (i >= first && _logclasses[i] != LogEntry::invalid_class &&
+                    ((1U << _logclasses[i]) & classes) != 0 &&
+                    static_cast<time_t>(_times[i]) >= since &&
+                    static_cast<time_t>(_times[i]) <= until) {
+                    process(i, offset, summary(i));
+                }
+                offset += static_cast<off_t>(_lengths[i]) + 1;
+            }
+        }
+    }
+
+private:
+    struct Block {
+        uint64_t _offset;  // of the first line
+        uint32_t _classes;
+        // the time range of the lines with a class
+        uint32_t _min_time;
+        uint32_t _max_time;
+        uint32_t _unused;
+    };
+
+    off_t _file_size;
+    size_t _num_lines;
+    time_t _min_time;
+    time_t _max_time;
+    const Block *_blocks;
+    const uint32_t *_times;
+    const uint32_t *_lengths;
+    const uint32_t *_options;
+    const int16_t *_defs;
+    const uint8_t *_logclasses;
+    const uint8_t *_types;
+    void *_map;  // only when read
+    size_t _map_length;
+    std::vector<std::pair<off_t, LogEntry::Summary>> _built;  // when building
+
+    static fs::path snapshotPath(const fs::path &logfile);
+    [[nodiscard]] bool isConsistent() const;
+    [[nodiscard]] LogEntry::Summary summary(size_t i) const {
+        return {_times[i],  _lengths[i],    _options[i],
+                _defs[i],   _logclasses[i], _types[i]};
+    }
+};
+
+#endif  // LogfileSnapshot_h
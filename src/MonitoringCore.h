@@ -97,6 +97,9 @@ public:
     virtual Encoding dataEncoding() = 0;
     virtual size_t maxResponseSize() = 0;
     virtual size_t maxCachedMessages() = 0;
+    // Not pure, so cores which don't know about this limit (like the CMC)
+    // keep working with the default of the NEB module.
+    virtual size_t maxCachedLogBytes() { return 256 * 1024 * 1024; }
 
     [[nodiscard]] virtual AuthorizationKind hostAuthorization() const = 0;
     [[nodiscard]] virtual AuthorizationKind serviceAuthorization() const = 0;
@@ -406,9 +406,15 @@ void Query::parseStatsLine(char *line) {
         auto operand = mk::lstrip(line);
         sc = std::make_unique<StatsColumnCount>(
             column->createFilter(Filter::Kind::stats, relOp, operand));
+        _unsummed_columns.insert(column);
     } else {
         column = _table.column(nextStringArgument(&line));
         sc = std::make_unique<StatsColumnOp>(it->second, column.get());
+        if (it->first == "sum") {
+            _summed_columns.push_back(column);
+        } else {
+            _unsummed_columns.insert(column);
+        }
     }
     _stats_columns.push_back(std::move(sc));
     _all_columns.insert(column);
@@ -424,6 +430,7 @@ void Query::parseFilterLine(char *line, FilterStack &filters) {
     auto sub_filter = column->createFilter(Filter::Kind::row, relOp, operand);
     filters.push_back(std::move(sub_filter));
     _all_columns.insert(column);
+    _unsummed_columns.insert(column);
 }
 
 void Query::parseAuthUserHeader(char *line) {
@@ -465,6 +472,7 @@ void Query::parseColumnsLine(char *line) {
         }
         _columns.push_back(column);
         _all_columns.insert(column);
+        _unsummed_columns.insert(column);
     }
     _show_column_headers = false;
 }
@@ -598,6 +606,21 @@ void Query::parseLocaltimeLine(char *line) {
 
 bool Query::doStats() const { return !_stats_columns.empty(); }
 
+bool Query::onlySums(
+    const std::function<bool(const Column &)> &is_additive,
+    const std::function<bool(const Column &)> &is_fixed) const {
+    if (!doStats() || _limit >= 0 ||
+        _summed_columns.size() != _stats_columns.size()) {
+        return false;
+    }
+    return std::all_of(_summed_columns.begin(), _summed_columns.end(),
+                       [&](const auto &c) { return is_additive(*c); }) &&
+           std::all_of(_columns.begin(), _columns.end(),
+                       [&](const auto &c) { return is_fixed(*c); }) &&
+           std::none_of(_unsummed_columns.begin(), _unsummed_columns.end(),
+                        [&](const auto &c) { return is_additive(*c); });
+}
+
 bool Query::process() {
     // Precondition: output has been reset
     auto start_time = std::chrono::system_clock::now();
@@ -742,6 +765,19 @@ std::optional<std::string> Query::stringValueRestrictionFor(
     return result;
 }
 
+std::optional<std::string> Query::requiredSubstringFor(
+    const std::string &column_name) const {
+    auto result = _filter->requiredSubstringFor(column_name);
+    if (result) {
+        Debug(_logger) << "column " << _table.name() << "." << column_name
+                       << " must contain '" << *result << "'";
+    } else {
+        Debug(_logger) << "column " << _table.name() << "." << column_name
+                       << " has no required substring";
+    }
+    return result;
+}
+
 std::optional<int32_t> Query::greatestLowerBoundFor(
     const std::string &column_name) const {
     auto result = _filter->greatestLowerBoundFor(column_name, timezoneOffset());
@@ -75,6 +75,8 @@ public:
         std::function<bool(const Column &)> predicate) const;
     std::optional<std::string> stringValueRestrictionFor(
         const std::string &column_name) const;
+    std::optional<std::string> requiredSubstringFor(
+        const std::string &column_name) const;
     std::optional<int32_t> greatestLowerBoundFor(
         const std::string &column_name) const;
     std::optional<int32_t> leastUpperBoundFor(
@@ -86,6 +88,13 @@ public:
         return _all_columns;
     }
 
+    // Whether the query only sums up columns for which is_additive holds, uses
+    // them nowhere else, groups only by columns for which is_fixed holds and
+    // has no limit. Rows which agree in all other columns can then be merged
+    // by summing up their additive columns without changing the result.
+    bool onlySums(const std::function<bool(const Column &)> &is_additive,
+                  const std::function<bool(const Column &)> &is_fixed) const;
+
 private:
     using LogicalConnective =
         std::function<std::unique_ptr<Filter>(Filter::Kind, Filters)>;
@@ -117,6 +126,9 @@ private:
     std::map<RowFragment, std::vector<std::unique_ptr<Aggregator>>>
         _stats_groups;
     std::unordered_set<std::shared_ptr<Column>> _all_columns;
+    // The columns of "Stats: sum" lines and all other columns, see onlySums()
+    std::vector<std::shared_ptr<Column>> _summed_columns;
+    std::unordered_set<std::shared_ptr<Column>> _unsummed_columns;
 
     bool doStats() const;
     void doWait();
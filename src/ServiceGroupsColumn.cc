@@ -30,6 +30,7 @@
 #include "ObjectGroup.h"
 #include "cmc.h"
 #else
+#include "Store.h"
 #include "auth.h"
 #include "nagios.h"
 #endif
@@ -58,3 +59,20 @@ std::vector<std::string> ServiceGroupsColumn::getValue(
 #endif
     return group_names;
 }
+
+bool ServiceGroupsColumn::contains(Row row, const contact *auth_user,
+                                   const std::string &value,
+                                   std::chrono::seconds timezone_offset) const {
+#ifndef CMC
+    const auto &index = _mc->impl<Store>()->_group_membership._service_groups;
+    if (auto p = columnData<objectlist *>(row)) {
+        if (auto member = index.find(p, value)) {
+            return *member != nullptr &&
+                   is_authorized_for_service_group(
+                       _mc, static_cast<const servicegroup *>(*member),
+                       auth_user);
+        }
+    }
+#endif
+    return ListColumn::contains(row, auth_user, value, timezone_offset);
+}
@@ -31,6 +31,8 @@
 #include "Service.h"
 #include "State.h"
 #else
+#include <array>
+#include "Store.h"
 #include "auth.h"
 #endif
 
@@ -44,6 +46,11 @@ int32_t ServiceListStateColumn::getValue(Row row,
 #else
     servicesmember *mem = nullptr;
     if (auto p = columnData<servicesmember *>(row)) {
+        StateAggregates::Services services;
+        if (auth_user == nullptr &&
+            _mc->impl<Store>()->_state_aggregates.servicesFor(p, services)) {
+            return getValueFromAggregate(_logictype, services);
+        }
         mem = *p;
     }
     return getValueFromServices(_mc, _logictype, mem, auth_user);
@@ -76,6 +83,49 @@ int32_t ServiceListStateColumn::getValueFromServices(MonitoringCore *mc,
     return result;
 }
 
+#ifndef CMC
+namespace {
+int32_t worstState(const std::array<int32_t, 4> &counts) {
+    int32_t result = 0;
+    for (int32_t state = 0; state < 4; ++state) {
+        if (counts[state] > 0 && worse(static_cast<ServiceState>(state),
+                                       static_cast<ServiceState>(result))) {
+            result = state;
+        }
+    }
+    return result;
+}
+}  // namespace
+
+// static
+int32_t ServiceListStateColumn::getValueFromAggregate(
+    Type logictype, const StateAggregates::Services &services) {
+    switch (logictype) {
+        case Type::num:
+            return services._num;
+        case Type::num_pending:
+            return services._num_pending;
+        case Type::worst_state:
+            return worstState(services._all_state);
+        case Type::worst_hard_state:
+            return worstState(services._all_hard_state);
+        case Type::num_ok:
+        case Type::num_warn:
+        case Type::num_crit:
+        case Type::num_unknown:
+            return services._num_state[static_cast<int>(logictype)];
+        case Type::num_hard_ok:
+        case Type::num_hard_warn:
+        case Type::num_hard_crit:
+        case Type::num_hard_unknown:
+            return services
+                ._num_hard_state[static_cast<int>(logictype) -
+                                 static_cast<int>(Type::num_hard_ok)];
+    }
+    return 0;  // unreachable
+}
+#endif
+
 // static
 void ServiceListStateColumn::update(Type logictype, service *svc,
                                     int32_t &result) {
@@ -36,6 +36,7 @@ class Row;
 #include "Host.h"
 #include "cmc.h"
 #else
+#include "StateAggregates.h"
 #include "nagios.h"
 #endif
 
@@ -78,6 +79,13 @@ public:
                                         service_list mem,
                                         const contact *auth_user);
 
+#ifndef CMC
+    // Same as getValueFromServices() without an AuthUser, but from the
+    // precomputed counts.
+    static int32_t getValueFromAggregate(
+        Type logictype, const StateAggregates::Services &services);
+#endif
+
 private:
     MonitoringCore *_mc;
     const Type _logictype;
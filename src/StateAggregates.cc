@@ -0,0 +1,176 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "StateAggregates.h"
+
+extern host *host_list;
+extern service *service_list;
+extern hostgroup *hostgroup_list;
+extern servicegroup *servicegroup_list;
+
+namespace {
+template <typename T, size_t N>
+void count(std::array<T, N> &counts, int state, int delta) {
+    if (state >= 0 && static_cast<size_t>(state) < N) {
+        counts[state] += delta;
+    }
+}
+}  // namespace
+
+void StateAggregates::rebuild() {
+    std::lock_guard<std::mutex> lg(_mutex);
+    _service_lists.clear();
+    _host_lists.clear();
+    _services.clear();
+    _hosts.clear();
+
+    for (host *hst = host_list; hst != nullptr; hst = hst->next) {
+        _hosts[hst] = {hst->current_state, hst->has_been_checked != 0, {}};
+    }
+    for (service *svc = service_list; svc != nullptr; svc = svc->next) {
+        _services[svc] = {svc->current_state, svc->last_hard_state,
+                          svc->has_been_checked != 0,
+                          {&_service_lists[&svc->host_ptr->services]}};
+    }
+    for (servicegroup *sg = servicegroup_list; sg != nullptr; sg = sg->next) {
+        Services &services = _service_lists[&sg->members];
+        for (servicesmember *mem = sg->members; mem != nullptr;
+             mem = mem->next) {
+            _services[mem->service_ptr]._targets.push_back(&services);
+        }
+    }
+    for (hostgroup *hg = hostgroup_list; hg != nullptr; hg = hg->next) {
+        Hosts &hosts = _host_lists[&hg->members];
+        for (hostsmember *mem = hg->members; mem != nullptr; mem = mem->next) {
+            _hosts[mem->host_ptr]._targets.push_back(&hosts);
+            for (servicesmember *smem = mem->host_ptr->services;
+                 smem != nullptr; smem = smem->next) {
+                _services[smem->service_ptr]._targets.push_back(
+                    &hosts._services);
+            }
+        }
+    }
+
+    for (const auto &entry : _services) {
+        for (auto services : entry.second._targets) {
+            add(*services, entry.second, 1);
+        }
+    }
+    for (const auto &entry : _hosts) {
+        for (auto hosts : entry.second._targets) {
+            add(*hosts, entry.second, 1);
+        }
+    }
+}
+
+void StateAggregates::update(const host *hst) {
+    std::lock_guard<std::mutex> lg(_mutex);
+    auto it = _hosts.find(hst);
+    if (it == _hosts.end()) {
+        return;
+    }
+    HostInfo &info = it->second;
+    bool checked = hst->has_been_checked != 0;
+    if (info._state == hst->current_state && info._checked == checked) {
+        return;
+    }
+    for (auto hosts : info._targets) {
+        add(*hosts, info, -1);
+    }
+    info._state = hst->current_state;
+    info._checked = checked;
+    for (auto hosts : info._targets) {
+        add(*hosts, info, 1);
+    }
+}
+
+void StateAggregates::update(const service *svc) {
+    std::lock_guard<std::mutex> lg(_mutex);
+    auto it = _services.find(svc);
+    if (it == _services.end()) {
+        return;
+    }
+    ServiceInfo &info = it->second;
+    bool checked = svc->has_been_checked != 0;
+    if (info._state == svc->current_state &&
+        info._hard_state == svc->last_hard_state && info._checked == checked) {
+        return;
+    }
+    for (auto services : info._targets) {
+        add(*services, info, -1);
+    }
+    info._state = svc->current_state;
+    info._hard_state = svc->last_hard_state;
+    info._checked = checked;
+    for (auto services : info._targets) {
+        add(*services, info, 1);
+    }
+}
+
+bool StateAggregates::servicesFor(const servicesmember *const *list,
+                                  Services &result) {
+    std::lock_guard<std::mutex> lg(_mutex);
+    auto it = _service_lists.find(list);
+    if (it == _service_lists.end()) {
+        return false;
+    }
+    result = it->second;
+    return true;
+}
+
+bool StateAggregates::hostsFor(const hostsmember *const *list,
+                               Hosts &result) {
+    std::lock_guard<std::mutex> lg(_mutex);
+    auto it = _host_lists.find(list);
+    if (it == _host_lists.end()) {
+        return false;
+    }
+    result = it->second;
+    return true;
+}
+
+// static
+void StateAggregates::add(Services &services, const ServiceInfo &info,
+                          int delta) {
+    services._num += delta;
+    if (info._checked) {
+        count(services._num_state, info._state, delta);
+        count(services._num_hard_state, info._hard_state, delta);
+    } else {
+        services._num_pending += delta;
+    }
+    count(services._all_state, info._state, delta);
+    count(services._all_hard_state, info._hard_state, delta);
+}
+
+// static
+void StateAggregates::add(Hosts &hosts, const HostInfo &info, int delta) {
+    hosts._num += delta;
+    if (info._checked) {
+        count(hosts._num_state, info._state, delta);
+    } else {
+        hosts._num_pending += delta;
+    }
+    count(hosts._all_state, info._state, delta);
+}
@@ -0,0 +1,97 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef StateAggregates_h
+#define StateAggregates_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "nagios.h"
+
+/// Service and host state counts per host (its services), per service group
+/// and per host group, updated incrementally when the state of a host or
+/// service changes. They reflect the view without an AuthUser, authorized
+/// queries still have to walk the members.
+class StateAggregates {
+public:
+    struct Services {
+        int32_t _num;
+        int32_t _num_pending;
+        // checked services by current_state/last_hard_state
+        std::array<int32_t, 4> _num_state;
+        std::array<int32_t, 4> _num_hard_state;
+        // all services by current_state/last_hard_state, for the worst state
+        std::array<int32_t, 4> _all_state;
+        std::array<int32_t, 4> _all_hard_state;
+    };
+
+    struct Hosts {
+        int32_t _num;
+        int32_t _num_pending;
+        std::array<int32_t, 3> _num_state;  // checked hosts by current_state
+        std::array<int32_t, 3> _all_state;  // all hosts by current_state
+        Services _services;                 // the services of all hosts
+    };
+
+    // Must be called from the Nagios thread.
+    void rebuild();
+    void update(const host *hst);
+    void update(const service *svc);
+
+    // Can be called from any thread. The aggregates are keyed by the address
+    // of the member list, i.e. &host::services, &servicegroup::members or
+    // &hostgroup::members. Returns false if there is no such aggregate.
+    bool servicesFor(const servicesmember *const *list, Services &result);
+    bool hostsFor(const hostsmember *const *list, Hosts &result);
+
+private:
+    struct ServiceInfo {
+        int _state;
+        int _hard_state;
+        bool _checked;
+        std::vector<Services *> _targets;
+    };
+
+    struct HostInfo {
+        int _state;
+        bool _checked;
+        std::vector<Hosts *> _targets;
+    };
+
+    // The mutex protects all fields below.
+    std::mutex _mutex;
+    std::unordered_map<const void *, Services> _service_lists;
+    std::unordered_map<const void *, Hosts> _host_lists;
+    std::unordered_map<const service *, ServiceInfo> _services;
+    std::unordered_map<const host *, HostInfo> _hosts;
+
+    static void add(Services &services, const ServiceInfo &info, int delta);
+    static void add(Hosts &hosts, const HostInfo &info, int delta);
+};
+
+#endif  // StateAggregates_h
@@ -0,0 +1,351 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "StateHistoryCache.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+StateHistoryCache::StateHistoryCache(time_t since)
+    : _since(since)
+    , _position{std::numeric_limits<time_t>::min(),
+                std::numeric_limits<time_t>::min(),
+                std::numeric_limits<int32_t>::min()}
+    , _first_row(0)
+    , _rows_since(since / seconds_per_day * seconds_per_day)
+    , _row_bytes(0)
+    , _first_day(_rows_since)
+    , _rolled_up_rows(0) {}
+
+namespace {
+HostServiceKey keyOf(const HostServiceState &hs_state) {
+    return hs_state._is_host ? static_cast<HostServiceKey>(hs_state._host)
+                             : static_cast<HostServiceKey>(hs_state._service);
+}
+
+// Strings short enough for the small string optimization need no heap block.
+size_t bytesOf(const std::string &str) {
+    return str.capacity() < sizeof(std::string) ? 0 : str.capacity() + 1;
+}
+
+size_t bytesOf(const StateHistoryCache::Row &row) {
+    return sizeof(row) + bytesOf(row._debug_info) + bytesOf(row._log_output);
+}
+}  // namespace
+
+void StateHistoryCache::addRow(const HostServiceState &hs_state,
+                               time_t entry_time) {
+    _rows.push_back(rowOf(addObject(hs_state), hs_state, entry_time));
+    _row_bytes += bytesOf(_rows.back());
+    auto it = _appearances.find(_rows.back()._object);
+    if (it != _appearances.end() && !it->second._ended) {
+        if (_rows.back()._state == -1) {
+            it->second._unmonitored_until = _rows.back()._until;
+        } else {
+            it->second._ended = true;
+        }
+    }
+}
+
+void StateHistoryCache::addAppearance(const HostServiceState &hs_state,
+                                      time_t t) {
+    _appearances[addObject(hs_state)] = Appearance{t, t, false};
+}
+
+bool StateHistoryCache::deniedGraceSince(time_t t) const {
+    for (const auto &[object, appearance] : _appearances) {
+        if (appearance._time - t > appearance_grace) {
+            continue;  // too late for a replay starting at t, too
+        }
+        // Without another row yet, it's the current state which tells
+        // whether the last UNMONITORED row has been ended by a new state.
+        bool still_unmonitored = false;
+        if (!appearance._ended) {
+            auto it = _states._state_info.find(keyOf(_objects[object]));
+            still_unmonitored = it != _states._state_info.end() &&
+                                it->second->_state == -1;
+        }
+        if (still_unmonitored || appearance._unmonitored_until >= t) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t StateHistoryCache::addObject(const HostServiceState &hs_state) {
+    auto it = _object_index.find(keyOf(hs_state));
+    if (it == _object_index.end()) {
+        it = _object_index.emplace(keyOf(hs_state), _objects.size()).first;
+        _objects.push_back(objectOf(hs_state));
+    }
+    return it->second;
+}
+
+// static
+StateHistoryCache::Row StateHistoryCache::rowOf(size_t object,
+                                                const HostServiceState &hs_state,
+                                                time_t entry_time) {
+    return Row{object,
+               entry_time,
+               hs_state._time,
+               hs_state._from,
+               hs_state._until,
+               hs_state._lineno,
+               hs_state._host_down,
+               hs_state._state,
+               hs_state._in_notification_period,
+               hs_state._in_service_period,
+               hs_state._in_downtime,
+               hs_state._in_host_downtime,
+               hs_state._is_flapping,
+               hs_state._debug_info,
+               hs_state._log_output};
+}
+
+// static
+StateHistoryCache::Span StateHistoryCache::spanOf(const Row &row) {
+    return Span{row._object, row._time, row._from, row._until, row._state};
+}
+
+size_t StateHistoryCache::firstRowAt(time_t t) const {
+    return _first_row +
+           (std::partition_point(
+                _rows.begin(), _rows.end(),
+                [t](const Row &row) { return row._entry_time < t; }) -
+            _rows.begin());
+}
+
+// A day more than the queries need, for those started a bit earlier. The rows
+// are only dropped when they have been summed up, and the sums only with the
+// rows.
+time_t StateHistoryCache::rowsExpireBefore(time_t now) const {
+    return std::min(now - max_age - seconds_per_day, rolledUpUntil());
+}
+
+time_t StateHistoryCache::daysExpireBefore(time_t now) const {
+    return std::min(now - max_rollup_age - seconds_per_day, _rows_since);
+}
+
+bool StateHistoryCache::hasExpired(time_t now) const {
+    return _rows_since + seconds_per_day <= rowsExpireBefore(now) ||
+           _first_day + seconds_per_day <= daysExpireBefore(now);
+}
+
+void StateHistoryCache::dropExpired(time_t now) {
+    for (auto t = rowsExpireBefore(now); _rows_since + seconds_per_day <= t;) {
+        _rows_since += seconds_per_day;
+    }
+    for (auto last = firstRowAt(_rows_since); _first_row < last;
+         ++_first_row) {
+        _row_bytes -= bytesOf(_rows.front());
+        _rows.pop_front();
+    }
+    // Queries need the states at their end, which is after the first day we
+    // have the rows of.
+    auto it = _checkpoints.upper_bound(_rows_since);
+    if (it != _checkpoints.begin()) {
+        _checkpoints.erase(_checkpoints.begin(), std::prev(it));
+    }
+    for (auto t = daysExpireBefore(now);
+         !_days.empty() && _first_day + seconds_per_day <= t;) {
+        _days.pop_front();
+        _first_day += seconds_per_day;
+    }
+    for (auto it = _appearances.begin(); it != _appearances.end();) {
+        if (it->second._ended && it->second._unmonitored_until < _first_day) {
+            it = _appearances.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void StateHistoryCache::Durations::add(int state, time_t duration) {
+    _total += duration;
+    if (state >= -1 && state <= 3) {
+        _state[state + 1] += duration;
+    }
+}
+
+void StateHistoryCache::Durations::add(const Durations &other) {
+    _total += other._total;
+    for (size_t i = 0; i < _state.size(); ++i) {
+        _state[i] += other._state[i];
+    }
+}
+
+void StateHistoryCache::rollUp(time_t t) {
+    for (auto start = rolledUpUntil(); start + seconds_per_day <= t;
+         start += seconds_per_day) {
+        Day day;
+        std::unordered_map<size_t, size_t> index;
+        for (auto last = firstRowAt(start + seconds_per_day);
+             _rolled_up_rows < last; ++_rolled_up_rows) {
+            const Row &row = this->row(_rolled_up_rows);
+            auto [it, inserted] =
+                index.emplace(row._object, day._rollups.size());
+            if (inserted) {
+                day._rollups.push_back(Rollup{spanOf(row), {}});
+            } else if (row._time < start) {
+                day._backdated_rows.push_back(spanOf(row));
+            }
+            day._rollups[it->second]._durations.add(row._state,
+                                                    row._until - row._from);
+        }
+        _days.push_back(std::move(day));
+    }
+}
+
+void StateHistoryCache::addCheckpoint(time_t logfile,
+                                      const HostServiceStates &states) {
+    if (_checkpoints.find(logfile) != _checkpoints.end()) {
+        return;
+    }
+    Checkpoint checkpoint{{},
+                          states._notification_periods,
+                          states._in_nagios_initial_states,
+                          0};
+    checkpoint._states.reserve(states._state_info.size());
+    checkpoint._bytes = checkpoint._states.capacity() * sizeof(ObjectState);
+    for (const auto &[name, active] : checkpoint._notification_periods) {
+        checkpoint._bytes += 4 * sizeof(void *) + sizeof(std::string) +
+                             bytesOf(name) + sizeof(active);
+    }
+    for (const auto &it_hst : states._state_info) {
+        const HostServiceState &hst = *it_hst.second;
+        ObjectState state{rowOf(addObject(hst), hst, 0),
+                          hst._may_no_longer_exist, hst._has_vanished,
+                          hst._last_known_time,
+                          {}};
+        for (const auto *svc : hst._services) {
+            state._services.push_back(addObject(*svc));
+        }
+        checkpoint._bytes += bytesOf(state._row) - sizeof(Row) +
+                             state._services.capacity() * sizeof(size_t);
+        checkpoint._states.push_back(std::move(state));
+    }
+    _checkpoints[logfile] = std::move(checkpoint);
+    if (_checkpoints.size() <= max_checkpoints) {
+        return;
+    }
+    // Keep the first and the last one, so all of the window stays covered.
+    auto victim = std::next(_checkpoints.begin());
+    for (auto it = victim; std::next(it) != _checkpoints.end(); ++it) {
+        if (std::next(it)->first - std::prev(it)->first <
+            std::next(victim)->first - std::prev(victim)->first) {
+            victim = it;
+        }
+    }
+    _checkpoints.erase(victim);
+}
+
+std::optional<time_t> StateHistoryCache::restoreCheckpoint(
+    time_t t, HostServiceStates &states) const {
+    auto it = _checkpoints.lower_bound(t);
+    if (it == _checkpoints.begin()) {
+        return {};
+    }
+    --it;
+    const Checkpoint &checkpoint = it->second;
+    states._state_info.clear();
+    states._arena.clear();
+    states._notification_periods = checkpoint._notification_periods;
+    states._in_nagios_initial_states = checkpoint._in_nagios_initial_states;
+    std::unordered_map<size_t, HostServiceState *> restored;
+    for (const auto &state : checkpoint._states) {
+        auto *hst = states._arena.allocate(_objects[state._row._object]);
+        applyRow(state._row, *hst);
+        hst->_may_no_longer_exist = state._may_no_longer_exist;
+        hst->_has_vanished = state._has_vanished;
+        hst->_last_known_time = state._last_known_time;
+        restored[state._row._object] = hst;
+        states._state_info.emplace(keyOf(*hst), hst);
+    }
+    for (const auto &state : checkpoint._states) {
+        auto &services = restored[state._row._object]->_services;
+        for (auto object : state._services) {
+            services.push_back(restored[object]);
+        }
+    }
+    return it->first;
+}
+
+// Each node of the maps has a few pointers besides its value.
+size_t StateHistoryCache::bytes() const {
+    size_t bytes = _row_bytes;
+    for (const auto &day : _days) {
+        bytes += sizeof(Day) + day._rollups.capacity() * sizeof(Rollup) +
+                 day._backdated_rows.capacity() * sizeof(Span);
+    }
+    for (const auto &it : _checkpoints) {
+        bytes += 4 * sizeof(void *) + sizeof(it) + it.second._bytes;
+    }
+    bytes += _appearances.size() *
+             (2 * sizeof(void *) + sizeof(size_t) + sizeof(Appearance));
+    bytes += _objects.capacity() * sizeof(HostServiceState) +
+             _object_index.size() * (2 * sizeof(void *) + sizeof(size_t)) +
+             _states._state_info.size() *
+                 (4 * sizeof(void *) + sizeof(HostServiceState));
+    return bytes;
+}
+
+size_t StateHistoryCache::findObject(HostServiceKey key) const {
+    auto it = _object_index.find(key);
+    return it == _object_index.end() ? _objects.size() : it->second;
+}
+
+size_t StateHistoryCache::findObject(const HostServiceState &hs_state) const {
+    return findObject(keyOf(hs_state));
+}
+
+// static
+HostServiceState StateHistoryCache::objectOf(const HostServiceState &hs_state) {
+    HostServiceState object;
+    object._is_host = hs_state._is_host;
+    object._host = hs_state._host;
+    object._service = hs_state._service;
+    object._host_name = hs_state._host_name;
+    object._service_description = hs_state._service_description;
+    object._notification_period = hs_state._notification_period;
+    object._service_period = hs_state._service_period;
+    return object;
+}
+
+// static
+void StateHistoryCache::applyRow(const Row &row, HostServiceState &hs_state) {
+    hs_state._time = row._time;
+    hs_state._from = row._from;
+    hs_state._until = row._until;
+    hs_state._lineno = row._lineno;
+    hs_state._host_down = row._host_down;
+    hs_state._state = row._state;
+    hs_state._in_notification_period = row._in_notification_period;
+    hs_state._in_service_period = row._in_service_period;
+    hs_state._in_downtime = row._in_downtime;
+    hs_state._in_host_downtime = row._in_host_downtime;
+    hs_state._is_flapping = row._is_flapping;
+    hs_state._debug_info = row._debug_info;
+    hs_state._log_output = row._log_output;
+}
@@ -0,0 +1,253 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef StateHistoryCache_h
+#define StateHistoryCache_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "HostServiceState.h"
+
+/// The rows of the statehist table for the last max_days days of the log, as
+/// the replay in TableStateHistory produces them, together with the state of
+/// all hosts and services after the last replayed entry. A query within that
+/// window only has to pick the rows of its time range instead of replaying the
+/// log, and the replay for new entries continues where it stopped. The fields
+/// of a row which never change for its host or service are kept only once.
+/// The rows of the days which have left the window are dropped.
+///
+/// The states at the start of some logfiles are kept as checkpoints, spread
+/// over the window, so a query ending before the last replayed entry only has
+/// to replay a few logfiles to know the states at its end.
+///
+/// For every complete day, the durations of the states of each object are
+/// summed up, so a query which only needs these sums over many days doesn't
+/// have to look at every row. These sums are kept for max_rollup_days days,
+/// so such a query can reach back further than the rows.
+class StateHistoryCache {
+public:
+    static constexpr size_t max_checkpoints = 32;
+    static constexpr time_t seconds_per_day = 24 * 60 * 60;
+    static constexpr time_t max_days = 31;
+    static constexpr time_t max_age = max_days * seconds_per_day;
+    static constexpr time_t max_rollup_days = 366;
+    static constexpr time_t max_rollup_age = max_rollup_days * seconds_per_day;
+    // An object appearing later than this after the start of a replay has
+    // been UNMONITORED until then, see TableStateHistory::replay().
+    static constexpr time_t appearance_grace = 60 * 10;
+
+    struct Row {
+        size_t _object;
+        time_t _entry_time;  // of the entry which has produced the row
+        time_t _time;
+        time_t _from;
+        time_t _until;
+        int32_t _lineno;
+        int _host_down;
+        int _state;
+        int _in_notification_period;
+        int _in_service_period;
+        int _in_downtime;
+        int _in_host_downtime;
+        int _is_flapping;
+        std::string _debug_info;
+        std::string _log_output;
+    };
+
+    // The time spent in each state, as summed up over rows.
+    struct Durations {
+        time_t _total;
+        std::array<time_t, 5> _state;  // UNMONITORED(-1), OK(0) ... UNKNOWN(3)
+
+        void add(int state, time_t duration);
+        void add(const Durations &other);
+    };
+
+    // What the sums need of a row, kept when the row is dropped.
+    struct Span {
+        size_t _object;
+        time_t _time;
+        time_t _from;
+        time_t _until;
+        int _state;
+    };
+
+    // The durations of the rows of an object produced by the entries of one
+    // day. A query starting on an earlier day clips the first of these rows
+    // at its start if the object has no earlier rows in its timeframe.
+    struct Rollup {
+        Span _first;
+        Durations _durations;
+    };
+
+    // The rollups of a day, together with the rows which are not the first
+    // one of their object but have a time before the day. Those are the rows
+    // up to the disappearance of an object which reappears on that day, and
+    // a query filters them out if they are before its start.
+    struct Day {
+        std::vector<Rollup> _rollups;
+        std::vector<Span> _backdated_rows;
+    };
+
+    // The last replayed entry, its logfile is identified by its start.
+    struct Position {
+        time_t _logfile;
+        time_t _time;
+        int32_t _lineno;
+    };
+
+    // The replay starts at the given time, see TableStateHistory::QueryState.
+    explicit StateHistoryCache(time_t since);
+
+    [[nodiscard]] time_t since() const { return _since; }
+    [[nodiscard]] Position position() const { return _position; }
+    void setPosition(Position position) { _position = position; }
+    HostServiceStates &states() { return _states; }
+    [[nodiscard]] const HostServiceStates &states() const { return _states; }
+
+    // The rows keep their index when older rows are dropped.
+    void addRow(const HostServiceState &hs_state, time_t entry_time);
+    [[nodiscard]] size_t numRows() const {
+        return _first_row + _rows.size();
+    }
+    [[nodiscard]] const Row &row(size_t i) const {
+        return _rows[i - _first_row];
+    }
+    // The index of the first row produced by an entry not older than t.
+    [[nodiscard]] size_t firstRowAt(time_t t) const;
+    // Drops the rows and the sums which have left their windows at the given
+    // time, keeping a day more than the queries need, for those started a bit
+    // earlier. Only rows which have been summed up are dropped.
+    void dropExpired(time_t now);
+    [[nodiscard]] bool hasExpired(time_t now) const;
+    // False if rows produced by entries at or after t have been dropped.
+    [[nodiscard]] bool keepsRowsSince(time_t t) const {
+        return _first_row == 0 || t >= _rows_since;
+    }
+
+    // Remembers an object which has been UNMONITORED from our start until it
+    // has appeared at the given time, because that was after the grace
+    // period. Its rows are watched to see how long it stays UNMONITORED.
+    void addAppearance(const HostServiceState &hs_state, time_t t);
+    // True if a replay starting at t would have granted an object the grace
+    // period we haven't, and that makes a difference at or after t.
+    [[nodiscard]] bool deniedGraceSince(time_t t) const;
+
+    // Remembers the states before the first entry of the given logfile,
+    // unless we have done so already. If there are too many checkpoints, the
+    // one closest to its neighbours is dropped.
+    void addCheckpoint(time_t logfile, const HostServiceStates &states);
+    // Restores the states of the latest checkpoint before t and returns its
+    // logfile, if there is any.
+    std::optional<time_t> restoreCheckpoint(time_t t,
+                                            HostServiceStates &states) const;
+
+    // Sums up the rows of all days (UTC) ending not after t.
+    void rollUp(time_t t);
+    // The start of the first summed up day which hasn't been dropped.
+    [[nodiscard]] time_t firstDay() const { return _first_day; }
+    // The end of the last summed up day.
+    [[nodiscard]] time_t rolledUpUntil() const {
+        return _first_day +
+               static_cast<time_t>(_days.size()) * seconds_per_day;
+    }
+    // The day starting at the given time, which must be a multiple of
+    // seconds_per_day before rolledUpUntil().
+    [[nodiscard]] const Day &day(time_t start) const {
+        return _days[(start - _first_day) / seconds_per_day];
+    }
+
+    // The host or service of rows, see objectOf().
+    [[nodiscard]] size_t numObjects() const { return _objects.size(); }
+    [[nodiscard]] const HostServiceState &object(size_t i) const {
+        return _objects[i];
+    }
+    // The index of the object with the given key, numObjects() if none.
+    [[nodiscard]] size_t findObject(HostServiceKey key) const;
+    // Dito for the object of a state, e.g. of one in another cache.
+    [[nodiscard]] size_t findObject(const HostServiceState &hs_state) const;
+    // The estimated memory used by the cache.
+    [[nodiscard]] size_t bytes() const;
+
+    // A state with only the fields of the given one which never change.
+    static HostServiceState objectOf(const HostServiceState &hs_state);
+    // Sets the fields of a row in a copy of its object.
+    static void applyRow(const Row &row, HostServiceState &hs_state);
+
+private:
+    // A HostServiceState without the fields of its object
+    struct ObjectState {
+        Row _row;
+        bool _may_no_longer_exist;
+        bool _has_vanished;
+        time_t _last_known_time;
+        std::vector<size_t> _services;
+    };
+
+    struct Appearance {
+        time_t _time;
+        time_t _unmonitored_until;  // the end of the last UNMONITORED row
+        bool _ended;                // a row with another state has followed
+    };
+
+    struct Checkpoint {
+        std::vector<ObjectState> _states;  // in the order of the keys
+        std::map<std::string, int> _notification_periods;
+        bool _in_nagios_initial_states;
+        size_t _bytes;
+    };
+
+    const time_t _since;
+    Position _position;
+    HostServiceStates _states;
+    std::vector<HostServiceState> _objects;
+    std::unordered_map<HostServiceKey, size_t> _object_index;
+    std::deque<Row> _rows;
+    std::unordered_map<size_t, Appearance> _appearances;  // by object
+    size_t _first_row;  // the index of the first row we still have
+    time_t _rows_since;  // the start of the first day we have the rows of
+    size_t _row_bytes;
+    std::map<time_t, Checkpoint> _checkpoints;
+    time_t _first_day;
+    std::deque<Day> _days;
+    size_t _rolled_up_rows;
+
+    size_t addObject(const HostServiceState &hs_state);
+    [[nodiscard]] time_t rowsExpireBefore(time_t now) const;
+    [[nodiscard]] time_t daysExpireBefore(time_t now) const;
+    static Span spanOf(const Row &row);
+    static Row rowOf(size_t object, const HostServiceState &hs_state,
+                     time_t entry_time);
+};
+
+#endif  // StateHistoryCache_h
@@ -45,7 +45,10 @@
 
 Store::Store(MonitoringCore *mc)
     : _mc(mc)
-    , _log_cache(mc, mc->maxCachedMessages())
+#ifndef CMC
+    , _tactical_overview(mc)
+#endif
+    , _log_cache(mc, mc->maxCachedMessages(), mc->maxCachedLogBytes())
     , _table_columns(mc)
     , _table_commands(mc)
     , _table_comments(mc)
@@ -66,7 +69,11 @@ Store::Store(MonitoringCore *mc)
     , _table_servicesbygroup(mc)
     , _table_servicesbyhostgroup(mc)
     , _table_statehistory(mc, &_log_cache)
-    , _table_status(mc)
+#ifndef CMC
+    , _table_status(mc, &_tactical_overview, &_log_cache)
+#else
+    , _table_status(mc, &_log_cache)
+#endif
     , _table_timeperiods(mc)
     , _table_dummy(mc) {
     addTable(_table_columns);
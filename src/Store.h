@@ -71,14 +71,17 @@ class Object;
 #else
 #include <mutex>
 #include "DowntimesOrComments.h"
+#include "GroupMembership.h"
+#include "StateAggregates.h"
+#include "TacticalOverview.h"
 #include "nagios.h"
 #endif
 
 class Store {
 public:
     explicit Store(MonitoringCore *mc);
-#ifdef CMC
     LogCache *logCache() { return &_log_cache; };
+#ifdef CMC
     bool answerRequest(InputBuffer *, OutputBuffer *);
     bool answerGetRequest(const std::list<std::string> &lines,
                           OutputBuffer &output, const std::string &tablename);
@@ -117,6 +120,9 @@ private:
 public:
     DowntimesOrComments _downtimes;
     DowntimesOrComments _comments;
+    TacticalOverview _tactical_overview;
+    StateAggregates _state_aggregates;
+    GroupMembership _group_membership;
 
 private:
 #endif
@@ -23,11 +23,182 @@
 // Boston, MA 02110-1301 USA.
 
 #include "StringFilter.h"
+#include <algorithm>
+#include <cctype>
 #include "Filter.h"
 #include "RegExp.h"
 #include "Row.h"
 #include "StringColumn.h"
 
+namespace {
+// The position of the last of the (hex) digits following the given position,
+// but not more than max_digits of them.
+size_t skipDigits(const std::string &regex, size_t pos, size_t max_digits,
+                  bool hex) {
+    for (size_t n = 0; n < max_digits && pos + 1 < regex.size(); ++n) {
+        auto ch = static_cast<unsigned char>(regex[pos + 1]);
+        if ((hex ? std::isxdigit(ch) : std::isdigit(ch)) == 0) {
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+// The position of the last character of the escape sequence at the given
+// backslash, which is followed by an alphanumeric character: \x41, \x{41},
+// octal \101, back references, \pL, \p{Greek}, \cA, or just \d, \b etc.
+size_t endOfEscape(const std::string &regex, size_t i) {
+    size_t pos = i + 1;
+    char c = regex[pos];
+    if ((c == 'x' || c == 'p' || c == 'P') && pos + 1 < regex.size() &&
+        regex[pos + 1] == '{') {
+        return regex.find('}', pos);
+    }
+    if (c == 'x') {
+        return skipDigits(regex, pos, 2, true);
+    }
+    if (std::isdigit(static_cast<unsigned char>(c)) != 0) {
+        return skipDigits(regex, pos, regex.size(), false);
+    }
+    if (c == 'p' || c == 'P' || c == 'c') {
+        return pos + 1 < regex.size() ? pos + 1 : pos;
+    }
+    return pos;
+}
+
+// The position of the ']' closing the character class at the given '['. The
+// engines disagree about backslashes within classes, so we give up on them.
+size_t endOfClass(const std::string &regex, size_t i) {
+    // a ']' right after the '[' or '[^' belongs to the class
+    size_t pos = i + 1;
+    if (pos < regex.size() && regex[pos] == '^') {
+        pos++;
+    }
+    if (pos < regex.size() && regex[pos] == ']') {
+        pos++;
+    }
+    for (; pos < regex.size(); ++pos) {
+        switch (regex[pos]) {
+            case ']':
+                return pos;
+            case '\\':
+                return std::string::npos;
+            case '[':
+                // [:digit:], [.-.] or [=a=]
+                if (pos + 1 < regex.size() &&
+                    (regex[pos + 1] == ':' || regex[pos + 1] == '.' ||
+                     regex[pos + 1] == '=')) {
+                    pos = regex.find(std::string{regex[pos + 1], ']'}, pos + 2);
+                    if (pos == std::string::npos) {
+                        return pos;
+                    }
+                    pos++;
+                }
+                break;
+        }
+    }
+    return std::string::npos;
+}
+
+// The longest literal which any match of the regular expression contains. We
+// are conservative here: Alternatives outside of groups make us give up, and
+// anything within groups or character classes is ignored. So we get "abc" for
+// "\x41abc", "\101abc", "[[:digit:]]abc" and "\Qabc\E", and nothing for
+// "ab|cd".
+std::string requiredLiteralOf(const std::string &regex) {
+    std::string best;
+    std::string current;
+    auto finish = [&]() {
+        if (current.size() > best.size()) {
+            best = current;
+        }
+        current.clear();
+    };
+    int depth = 0;  // of groups
+    for (size_t i = 0; i < regex.size(); ++i) {
+        char c = regex[i];
+        switch (c) {
+            case '|':
+                if (depth == 0) {
+                    return "";
+                }
+                break;
+            case '\\':
+                if (i + 1 == regex.size()) {
+                    return "";
+                }
+                if (regex[i + 1] == 'Q') {
+                    // quoted up to \E or the end
+                    size_t end = regex.find("\\E", i + 2);
+                    if (end == std::string::npos) {
+                        end = regex.size();
+                    }
+                    if (depth == 0) {
+                        current += regex.substr(i + 2, end - (i + 2));
+                    }
+                    i = end + 1;
+                } else if (std::isalnum(
+                               static_cast<unsigned char>(regex[i + 1])) != 0) {
+                    finish();
+                    i = endOfEscape(regex, i);
+                    if (i == std::string::npos) {
+                        return "";
+                    }
+                } else {
+                    if (depth == 0) {
+                        current += regex[i + 1];
+                    }
+                    ++i;
+                }
+                break;
+            case '[':
+                finish();
+                i = endOfClass(regex, i);
+                if (i == std::string::npos) {
+                    return "";
+                }
+                break;
+            case '(':
+                finish();
+                depth++;
+                break;
+            case ')':
+                depth--;
+                break;
+            case '*':
+            case '?':
+            case '{':
+                // the previous character is optional
+                if (!current.empty()) {
+                    current.pop_back();
+                }
+                finish();
+                if (c == '{') {
+                    i = regex.find('}', i);
+                    if (i == std::string::npos) {
+                        return "";
+                    }
+                }
+                break;
+            case '+':
+            case '.':
+            case '^':
+            case '$':
+                finish();
+                break;
+            default:
+                if (depth == 0) {
+                    current += c;
+                }
+                break;
+        }
+    }
+    finish();
+    return best;
+}
+}  // namespace
+
 StringFilter::StringFilter(Kind kind, const StringColumn &column,
                            RelationalOperator relOp, const std::string &value)
     : ColumnFilter(kind, column, relOp, value)
@@ -87,6 +258,42 @@ std::optional<std::string> StringFilter::stringValueRestrictionFor(
     return {};  // unreachable
 }
 
+std::optional<std::string> StringFilter::requiredSubstringFor(
+    const std::string &column_name) const {
+    if (column_name != columnName()) {
+        return {};  // wrong column
+    }
+    std::string text;
+    switch (oper()) {
+        case RelationalOperator::equal:
+        case RelationalOperator::equal_icase:
+            text = value();
+            break;
+        case RelationalOperator::matches:
+        case RelationalOperator::matches_icase:
+            text = requiredLiteralOf(value());
+            break;
+        case RelationalOperator::not_equal:
+        case RelationalOperator::doesnt_match:
+        case RelationalOperator::not_equal_icase:
+        case RelationalOperator::doesnt_match_icase:
+        case RelationalOperator::less:
+        case RelationalOperator::greater_or_equal:
+        case RelationalOperator::greater:
+        case RelationalOperator::less_or_equal:
+            return {};
+    }
+    // Only ASCII letters are case-folded consistently everywhere.
+    if (text.empty() ||
+        ((oper() == RelationalOperator::equal_icase ||
+          oper() == RelationalOperator::matches_icase) &&
+         std::any_of(text.begin(), text.end(),
+                     [](char c) { return (c & 0x80) != 0; }))) {
+        return {};
+    }
+    return {text};
+}
+
 std::unique_ptr<Filter> StringFilter::copy() const {
     return std::make_unique<StringFilter>(*this);
 }
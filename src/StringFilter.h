@@ -46,6 +46,8 @@ public:
                  std::chrono::seconds timezone_offset) const override;
     [[nodiscard]] std::optional<std::string> stringValueRestrictionFor(
         const std::string &column_name) const override;
+    [[nodiscard]] std::optional<std::string> requiredSubstringFor(
+        const std::string &column_name) const override;
     [[nodiscard]] std::unique_ptr<Filter> copy() const override;
     [[nodiscard]] std::unique_ptr<Filter> negate() const override;
 
@@ -53,6 +53,11 @@ bool starts_with(const std::string &input, const std::string &test) {
            std::equal(test.begin(), test.end(), input.begin());
 }
 
+bool ends_with(const std::string &input, const std::string &test) {
+    return input.size() >= test.size() &&
+           std::equal(test.rbegin(), test.rend(), input.rbegin());
+}
+
 std::vector<std::string> split(const std::string &str, char delimiter) {
     std::istringstream iss(str);
     std::vector<std::string> result;
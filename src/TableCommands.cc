@@ -32,7 +32,7 @@
 #include "Row.h"
 
 TableCommands::TableCommands(MonitoringCore *mc) : Table(mc) {
-    addColumns(this, "", 0);
+    addColumns(this, "", -1, 0);
 }
 
 std::string TableCommands::name() const { return "commands"; }
@@ -41,12 +41,12 @@ std::string TableCommands::namePrefix() const { return "command_"; }
 
 // static
 void TableCommands::addColumns(Table *table, const std::string &prefix,
-                               int offset) {
+                               int indirect_offset, int offset) {
     table->addColumn(std::make_unique<OffsetSStringColumn>(
-        prefix + "name", "The name of the command", -1, -1, -1,
+        prefix + "name", "The name of the command", indirect_offset, -1, -1,
         offset + DANGEROUS_OFFSETOF(Command, _name)));
     table->addColumn(std::make_unique<OffsetSStringColumn>(
-        prefix + "line", "The shell command line", -1, -1, -1,
+        prefix + "line", "The shell command line", indirect_offset, -1, -1,
         offset + DANGEROUS_OFFSETOF(Command, _command_line)));
 }
 
@@ -28,6 +28,7 @@
 #include "Column.h"
 #include "DowntimeOrComment.h"
 #include "DowntimesOrComments.h"
+#include "Logger.h"
 #include "MonitoringCore.h"
 #include "OffsetBoolColumn.h"
 #include "OffsetIntColumn.h"
@@ -94,7 +95,23 @@ std::string TableDowntimes::name() const { return "downtimes"; }
 std::string TableDowntimes::namePrefix() const { return "downtime_"; }
 
 void TableDowntimes::answerQuery(Query *query) {
-    for (const auto &entry : core()->impl<Store>()->_downtimes) {
+    auto &entries = core()->impl<Store>()->_downtimes;
+    // do we know the host?
+    if (auto value = query->stringValueRestrictionFor("host_name")) {
+        Debug(logger()) << "using host name index with '" << *value << "'";
+        // Older Nagios headers are not const-correct... :-P
+        if (host *hst = find_host(const_cast<char *>(value->c_str()))) {
+            for (const auto *entry : entries.forHost(hst)) {
+                if (!query->processDataset(Row(entry))) {
+                    break;
+                }
+            }
+            return;
+        }
+    }
+
+    Debug(logger()) << "using full table scan";
+    for (const auto &entry : entries) {
         if (!query->processDataset(Row(entry.second.get()))) {
             break;
         }
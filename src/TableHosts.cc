@@ -452,7 +452,7 @@ void TableHosts::addColumns(Table *table, const std::string &prefix,
     table->addColumn(std::make_unique<HostContactsColumn>(
         prefix + "contacts",
         "A list of all contacts of this host, either direct or via a contact group",
-        indirect_offset, extra_offset, -1, 0));
+        indirect_offset, extra_offset, -1, 0, table->core()));
     table->addColumn(std::make_unique<DowntimeColumn>(
         prefix + "downtimes",
         "A list of the ids of all scheduled downtimes of this host",
@@ -619,7 +619,8 @@ void TableHosts::addColumns(Table *table, const std::string &prefix,
     table->addColumn(std::make_unique<ContactGroupsColumn>(
         prefix + "contact_groups",
         "A list of all contact groups this host is in", indirect_offset,
-        extra_offset, -1, DANGEROUS_OFFSETOF(host, contact_groups)));
+        extra_offset, -1, DANGEROUS_OFFSETOF(host, contact_groups),
+        table->core()));
 
     table->addColumn(std::make_unique<ServiceListColumn>(
         prefix + "services", "A list of all services of the host",
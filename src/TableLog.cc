@@ -23,21 +23,25 @@
 // Boston, MA 02110-1301 USA.
 
 #include "TableLog.h"
+#include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <unordered_set>
 #include <utility>
 #include "Column.h"
 #include "LogCache.h"
 #include "LogEntry.h"
+#include "LogEntryStringColumn.h"
+#include "LogTrigramIndex.h"
 #include "Logfile.h"
 #include "OffsetIntColumn.h"
-#include "OffsetSStringColumn.h"
-#include "OffsetStringColumn.h"
 #include "OffsetTimeColumn.h"
 #include "Query.h"
 #include "Row.h"
@@ -53,6 +57,12 @@
 #include "nagios.h"
 #endif
 
+namespace {
+// The columns which don't need LogEntry::parseFields().
+const std::unordered_set<std::string> unparsed_columns{
+    "time", "lineno", "class", "message", "type", "options"};
+}  // namespace
+
 TableLog::TableLog(MonitoringCore *mc, LogCache *log_cache)
     : Table(mc), _log_cache(log_cache) {
     addColumn(std::make_unique<OffsetTimeColumn>(
@@ -65,48 +75,48 @@ TableLog::TableLog(MonitoringCore *mc, LogCache *log_cache)
         "class",
         "The class of the message as integer (0:info, 1:state, 2:program, 3:notification, 4:passive, 5:command)",
         -1, -1, -1, DANGEROUS_OFFSETOF(LogEntry, _logclass)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "message", "The complete message line including the timestamp", -1, -1,
-        -1, DANGEROUS_OFFSETOF(LogEntry, _complete)));
-    addColumn(std::make_unique<OffsetStringColumn>(
+        -1, -1, LogEntryStringColumn::Type::message));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "type",
         "The type of the message (text before the colon), the message itself for info messages",
-        -1, -1, -1, DANGEROUS_OFFSETOF(LogEntry, _text)));
-    addColumn(std::make_unique<OffsetStringColumn>(
-        "options", "The part of the message after the ':'", -1, -1, -1,
-        DANGEROUS_OFFSETOF(LogEntry, _options)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+        -1, -1, -1, -1, LogEntryStringColumn::Type::type));
+    addColumn(std::make_unique<LogEntryStringColumn>(
+        "options", "The part of the message after the ':'", -1, -1, -1, -1,
+        LogEntryStringColumn::Type::options));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "comment", "A comment field used in various message types", -1, -1, -1,
-        DANGEROUS_OFFSETOF(LogEntry, _comment)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+        -1, LogEntryStringColumn::Type::comment));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "plugin_output",
         "The output of the check, if any is associated with the message", -1,
-        -1, -1, DANGEROUS_OFFSETOF(LogEntry, _check_output)));
+        -1, -1, -1, LogEntryStringColumn::Type::plugin_output));
     addColumn(std::make_unique<OffsetIntColumn>(
         "state", "The state of the host or service in question", -1, -1, -1,
         DANGEROUS_OFFSETOF(LogEntry, _state)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "state_type", "The type of the state (varies on different log classes)",
-        -1, -1, -1, DANGEROUS_OFFSETOF(LogEntry, _state_type)));
+        -1, -1, -1, -1, LogEntryStringColumn::Type::state_type));
     addColumn(std::make_unique<OffsetIntColumn>(
         "attempt", "The number of the check attempt", -1, -1, -1,
         DANGEROUS_OFFSETOF(LogEntry, _attempt)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "service_description",
         "The description of the service log entry is about (might be empty)",
-        -1, -1, -1, DANGEROUS_OFFSETOF(LogEntry, _svc_desc)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+        -1, -1, -1, -1, LogEntryStringColumn::Type::service_description));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "host_name",
         "The name of the host the log entry is about (might be empty)", -1, -1,
-        -1, DANGEROUS_OFFSETOF(LogEntry, _host_name)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+        -1, -1, LogEntryStringColumn::Type::host_name));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "contact_name",
         "The name of the contact the log entry is about (might be empty)", -1,
-        -1, -1, DANGEROUS_OFFSETOF(LogEntry, _contact_name)));
-    addColumn(std::make_unique<OffsetSStringColumn>(
+        -1, -1, -1, LogEntryStringColumn::Type::contact_name));
+    addColumn(std::make_unique<LogEntryStringColumn>(
         "command_name",
         "The name of the command of the log entry (e.g. for notifications)", -1,
-        -1, -1, DANGEROUS_OFFSETOF(LogEntry, _command_name)));
+        -1, -1, -1, LogEntryStringColumn::Type::command_name));
 
     // join host and service tables
     TableHosts::addColumns(this, "current_host_",
@@ -117,7 +127,7 @@ TableLog::TableLog(MonitoringCore *mc, LogCache *log_cache)
     TableContacts::addColumns(this, "current_contact_",
                               DANGEROUS_OFFSETOF(LogEntry, _contact));
     TableCommands::addColumns(this, "current_command_",
-                              DANGEROUS_OFFSETOF(LogEntry, _command));
+                              DANGEROUS_OFFSETOF(LogEntry, _command), 0);
 }
 
 std::string TableLog::name() const { return "log"; }
@@ -125,9 +135,8 @@ std::string TableLog::name() const { return "log"; }
 std::string TableLog::namePrefix() const { return "log_"; }
 
 void TableLog::answerQuery(Query *query) {
-    std::lock_guard<std::mutex> lg(_log_cache->_lock);
-    _log_cache->update();
-    if (_log_cache->begin() == _log_cache->end()) {
+    auto logfiles = _log_cache->logfiles();
+    if (logfiles->empty()) {
         return;
     }
 
@@ -147,18 +156,28 @@ void TableLog::answerQuery(Query *query) {
         return;
     }
 
+    // Only the time and class of the entries are parsed when loading, the
+    // other fields are only parsed for queries which need them.
+    bool parse_fields =
+        query->authUser() != nullptr ||
+        std::any_of(query->allColumns().begin(), query->allColumns().end(),
+                    [](const auto &column) {
+                        return unparsed_columns.find(column->name()) ==
+                               unparsed_columns.end();
+                    });
+
     /* This code start with the oldest log entries. I'm going
        to change this and start with the newest. That way,
        the Limit: header produces more reasonable results. */
 
     /* NEW CODE - NEWEST FIRST */
-    auto it = _log_cache->end();  // it now points beyond last log file
+    auto it = logfiles->end();  // it now points beyond last log file
     --it;  // switch to last logfile (we have at least one)
 
     // Now find newest log where 'until' is contained. The problem
     // here: For each logfile we only know the time of the *first* entry,
     // not that of the last.
-    while (it != _log_cache->begin() && it->first > until) {
+    while (it != logfiles->begin() && it->first > until) {
         // while logfiles are too new go back in history
         --it;
     }
@@ -166,15 +185,49 @@ void TableLog::answerQuery(Query *query) {
         return;  // all logfiles are too new
     }
 
+    // Queries for a host, and maybe one of its services, only visit their
+    // entries, see LogHostIndex.
+    auto host_name = query->stringValueRestrictionFor("host_name");
+    auto service_description =
+        host_name ? query->stringValueRestrictionFor("service_description")
+                  : std::nullopt;
+
+    // Searches for a text in the messages skip the entries which can't
+    // contain it, see LogTrigramIndex. The plugin output is part of the
+    // message.
+    auto text = query->requiredSubstringFor("message");
+    if (!text) {
+        text = query->requiredSubstringFor("plugin_output");
+    }
+    auto trigrams = LogTrigramIndex::trigramsOf(text.value_or(std::string()));
+
+    // The older logfiles which might contain entries since the start of the
+    // time range are loaded in the background while we scan the newer ones.
+    // The loads which have not been started when we are done are cancelled.
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    auto prefetched = it;  // the oldest logfile loaded or being loaded
     while (true) {
-        if (!it->second->answerQueryReverse(query, since, until, classmask)) {
+        while (prefetched != logfiles->begin() && prefetched->first > since &&
+               static_cast<size_t>(std::distance(prefetched, it)) <
+                   LogCache::prefetch_depth) {
+            --prefetched;
+            if (!host_name ||
+                prefetched->second->mightMentionHost(*host_name, classmask)) {
+                _log_cache->prefetch(prefetched->second, classmask, since,
+                                     cancelled);
+            }
+        }
+        if (!it->second->answerQueryReverse(query, since, until, classmask,
+                                            parse_fields, host_name,
+                                            service_description, trigrams)) {
             break;  // end of time range found
         }
-        if (it == _log_cache->begin()) {
+        if (it == logfiles->begin()) {
             break;  // this was the oldest one
         }
         --it;
     }
+    *cancelled = true;
 }
 
 bool TableLog::isAuthorized(Row row, const contact *ctc) const {
@@ -406,7 +406,7 @@ void TableServices::addColumns(Table *table, const std::string &prefix,
     table->addColumn(std::make_unique<ServiceContactsColumn>(
         prefix + "contacts",
         "A list of all contacts of the service, either direct or via a contact group",
-        indirect_offset, -1, -1, 0));
+        indirect_offset, -1, -1, 0, table->core()));
     table->addColumn(std::make_unique<DowntimeColumn>(
         prefix + "downtimes", "A list of all downtime ids of the service",
         indirect_offset, -1, -1, 0, table->core(), true, false));
@@ -453,7 +453,7 @@ void TableServices::addColumns(Table *table, const std::string &prefix,
     table->addColumn(std::make_unique<ContactGroupsColumn>(
         prefix + "contact_groups",
         "A list of all contact groups this service is in", indirect_offset, -1,
-        -1, DANGEROUS_OFFSETOF(service, contact_groups)));
+        -1, DANGEROUS_OFFSETOF(service, contact_groups), table->core()));
 
     table->addColumn(std::make_unique<MetricsColumn>(
         prefix + "metrics",
@@ -23,14 +23,20 @@
 // Boston, MA 02110-1301 USA.
 
 #include "TableStateHistory.h"
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <ctime>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <ostream>
-#include <set>
+#include <shared_mutex>
 #include <stdexcept>
+#include <thread>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include "Column.h"
@@ -46,6 +52,7 @@
 #include "OringFilter.h"  // IWYU pragma: keep
 #include "Query.h"
 #include "Row.h"
+#include "StateHistoryCache.h"
 #include "StringUtils.h"
 #include "TableHosts.h"
 #include "TableServices.h"
@@ -72,6 +79,22 @@ constexpr unsigned classmask_statehist =
     (1U << static_cast<int>(LogEntry::Class::program)) |  //
     (1U << static_cast<int>(LogEntry::Class::state)) |    //
     (1U << static_cast<int>(LogEntry::Class::text));
+
+// A replay in shards is only worth it for a timeframe with more entries than
+// fit into a chunk, see TableStateHistory::replayChunkInShards().
+constexpr size_t chunk_size = 50000;
+constexpr size_t max_shards = 8;
+
+size_t numShards() {
+    return std::clamp<size_t>(std::thread::hardware_concurrency(), 1,
+                              max_shards);
+}
+
+// A host and its services are always replayed in the same shard.
+size_t shardOf(const void *host, size_t num_shards) {
+    return std::hash<const void *>{}(host) / alignof(std::max_align_t) %
+           num_shards;
+}
 }  // namespace
 
 #ifndef CMC
@@ -85,11 +108,26 @@ std::string getCustomVariable(customvariablesmember *cvm,
     }
     return "";
 }
+
+// The columns which can be summed up over the rows of an object.
+bool isDurationColumn(const Column &column) {
+    return mk::starts_with(column.name(), "duration");
+}
+
+// The columns which are the same in all rows of an object.
+bool isObjectColumn(const Column &column) {
+    const auto &name = column.name();
+    return mk::starts_with(name, "current_") || name == "host_name" ||
+           name == "service_description" || name == "notification_period" ||
+           name == "service_period";
+}
 }  // namespace
 #endif
 
 TableStateHistory::TableStateHistory(MonitoringCore *mc, LogCache *log_cache)
-    : Table(mc), _log_cache(log_cache) {
+    : Table(mc)
+    , _log_cache(log_cache)
+    , _shard_replayers(numShards() - 1) {
     addColumn(std::make_unique<OffsetTimeColumn>(
         "time", "Time of the log event (seconds since 1/1/1970)", -1, -1, -1,
         DANGEROUS_OFFSETOF(HostServiceState, _time)));
@@ -205,38 +243,76 @@ std::string TableStateHistory::name() const { return "statehist"; }
 
 std::string TableStateHistory::namePrefix() const { return "statehist_"; }
 
-void TableStateHistory::getPreviousLogentry() {
-    while (_it_entries == _entries->begin()) {
-        // open previous logfile
-        if (_it_logs == _log_cache->begin()) {
-            return;
-        }
-        --_it_logs;
-        _entries = _it_logs->second->getEntriesFor(classmask_statehist);
-        _it_entries = _entries->end();
-    }
-    --_it_entries;
-}
-
-LogEntry *TableStateHistory::getNextLogentry() {
+TableStateHistory::QueryState::QueryState(
+    Query *query, std::shared_ptr<const logfiles_t> logfiles)
+    : _query(query)
+    , _cache(nullptr)
+    , _object_filter(nullptr)
+    , _query_timeframe(0)
+    , _since(0)
+    , _until(0)
+    // This flag might be set to true by the return value of processDataset()
+    , _abort_query(false)
+    , _entry_time(0)
+    , _shard(0)
+    , _num_shards(1)
+    , _entry_index(0)
+    , _order_key(nullptr)
+    , _transition(nullptr)
+    , _logfiles(std::move(logfiles)) {}
+
+const LogEntry *TableStateHistory::QueryState::getNextLogentry() {
     if (_it_entries != _entries->end()) {
         ++_it_entries;
     }
 
     while (_it_entries == _entries->end()) {
         auto it_logs_cpy = _it_logs;
-        if (++it_logs_cpy == _log_cache->end()) {
+        if (++it_logs_cpy == _logfiles->end()) {
             return nullptr;
         }
         ++_it_logs;
         _entries = _it_logs->second->getEntriesFor(classmask_statehist);
         _it_entries = _entries->begin();
     }
-    return _it_entries->second.get();
+    return &*_it_entries;
 }
 
-namespace {
-class TimeperiodTransition {
+// Collects the next entries of the timeframe, keeping the entries of their
+// logfiles alive. Returns false when the end of the timeframe is reached.
+bool TableStateHistory::QueryState::getNextChunk(
+    std::vector<const LogEntry *> &chunk,
+    std::vector<std::shared_ptr<const LogfileEntries>> &chunk_entries) {
+    chunk.clear();
+    chunk_entries.clear();
+    while (chunk.size() < chunk_size) {
+        const LogEntry *entry = getNextLogentry();
+        if (entry == nullptr || entry->_time >= _until) {
+            return false;
+        }
+        if (chunk_entries.empty() || chunk_entries.back() != _entries) {
+            chunk_entries.push_back(_entries);
+        }
+        chunk.push_back(entry);
+    }
+    return true;
+}
+
+bool TableStateHistory::QueryState::output(HostServiceState *hs_state) {
+    if (_cache != nullptr) {
+        _cache->addRow(*hs_state, _entry_time);
+        return true;
+    }
+    if (_num_shards > 1) {
+        _pending.push_back(PendingRow{_entry_index, _order_key, *hs_state});
+        // The services of a host are only needed for the replay.
+        _pending.back()._state._services.clear();
+        return true;
+    }
+    return _query == nullptr || _query->processDataset(Row(hs_state));
+}
+
+class TableStateHistory::TimeperiodTransition {
 public:
     explicit TimeperiodTransition(const std::string &str) {
         auto fields = mk::split(str, ';');
@@ -248,7 +324,7 @@ public:
         _to = std::stoi(fields[2]);
     }
 
-    [[nodiscard]] std::string name() const { return _name; }
+    [[nodiscard]] const std::string &name() const { return _name; }
     [[nodiscard]] int from() const { return _from; }
     [[nodiscard]] int to() const { return _to; }
 
@@ -257,7 +333,6 @@ private:
     int _from;
     int _to;
 };
-}  // namespace
 
 // Create a partial filter, that contains only such filters that check
 // attributes of current hosts and services
@@ -275,376 +350,938 @@ std::unique_ptr<Filter> TableStateHistory::createPartialFilter(
 
 void TableStateHistory::answerQuery(Query *query) {
     auto object_filter = createPartialFilter(*query);
-    std::lock_guard<std::mutex> lg(_log_cache->_lock);
-    _log_cache->update();
-    if (_log_cache->begin() == _log_cache->end()) {
+    QueryState qs(query, _log_cache->logfiles());
+    if (qs._logfiles->empty()) {
         return;
     }
-
-    // This flag might be set to true by the return value of processDataset(...)
-    _abort_query = false;
-
-    // Keep track of the historic state of services/hosts here
-    std::map<HostServiceKey, HostServiceState *> state_info;
-
-    // Store hosts/services that we have filtered out here
-    std::set<HostServiceKey> object_blacklist;
+    qs._object_filter = object_filter.get();
 
     // Optimize time interval for the query. In log querys there should always
     // be a time range in form of one or two filter expressions over time. We
     // use that to limit the number of logfiles we need to scan and to find the
     // optimal entry point into the logfile
     if (auto glb = query->greatestLowerBoundFor("time")) {
-        _since = *glb;
+        qs._since = *glb;
     } else {
         query->invalidRequest(
             "Start of timeframe required. e.g. Filter: time > 1234567890");
         return;
     }
-    _until = query->leastUpperBoundFor("time").value_or(time(nullptr)) + 1;
+    qs._until =
+        query->leastUpperBoundFor("time").value_or(time(nullptr)) + 1;
 
-    _query_timeframe = _until - _since - 1;
-    if (_query_timeframe == 0) {
+    qs._query_timeframe = qs._until - qs._since - 1;
+    if (qs._query_timeframe == 0) {
         query->invalidRequest("Query timeframe is 0 seconds");
         return;
     }
 
+#ifndef CMC
+    if (answerQueryFromCache(qs)) {
+        return;
+    }
+#endif
+
     // Switch to last logfile (we have at least one)
-    _it_logs = _log_cache->end();
-    --_it_logs;
-    auto newest_log = _it_logs;
+    qs._it_logs = qs._logfiles->end();
+    --qs._it_logs;
+    auto newest_log = qs._it_logs;
 
     // Now find the log where 'since' starts.
-    while (_it_logs != _log_cache->begin() && _it_logs->first >= _since) {
-        --_it_logs;  // go back in history
+    while (qs._it_logs != qs._logfiles->begin() &&
+           qs._it_logs->first >= qs._since) {
+        --qs._it_logs;  // go back in history
     }
 
     // Check if 'until' is within these logfiles
-    if (_it_logs->first > _until) {
+    if (qs._it_logs->first > qs._until) {
         // All logfiles are too new, invalid timeframe
         // -> No data available. Return empty result.
         return;
     }
 
     // Determine initial logentry
-    _entries = _it_logs->second->getEntriesFor(classmask_statehist);
-    if (!_entries->empty() && _it_logs != newest_log) {
-        _it_entries = _entries->end();
+    qs._entries = qs._it_logs->second->getEntriesFor(classmask_statehist);
+    if (!qs._entries->empty() && qs._it_logs != newest_log) {
+        qs._it_entries = qs._entries->end();
         // Check last entry. If it's younger than _since -> use this logfile too
-        if (--_it_entries != _entries->begin()) {
-            if (_it_entries->second->_time >= _since) {
-                _it_entries = _entries->begin();
+        if (--qs._it_entries != qs._entries->begin()) {
+            if (qs._it_entries->_time >= qs._since) {
+                qs._it_entries = qs._entries->begin();
             }
         }
     } else {
-        _it_entries = _entries->begin();
+        qs._it_entries = qs._entries->begin();
     }
 
-    // From now on use getPreviousLogentry() / getNextLogentry()
+    // From now on use getNextChunk(). A timeframe with more than a single
+    // chunk of entries is replayed in shards.
+    std::vector<const LogEntry *> chunk;
+    std::vector<std::shared_ptr<const LogfileEntries>> chunk_entries;
+    std::vector<std::unique_ptr<QueryState>> shards;
     bool only_update = true;
-    bool in_nagios_initial_states = false;
+    size_t index = 0;
+    for (bool more = true; more && !qs._abort_query; index += chunk.size()) {
+        more = qs.getNextChunk(chunk, chunk_entries);
+        if (index == 0 && more && numShards() > 1) {
+            for (size_t i = 0; i < numShards(); ++i) {
+                auto shard = std::make_unique<QueryState>(query, qs._logfiles);
+                shard->_object_filter = qs._object_filter;
+                shard->_query_timeframe = qs._query_timeframe;
+                shard->_since = qs._since;
+                shard->_until = qs._until;
+                shard->_shard = i;
+                shard->_num_shards = numShards();
+                shards.push_back(std::move(shard));
+            }
+        }
+        // The start of the query timeframe within the chunk, if any
+        size_t split = std::find_if(chunk.begin(), chunk.end(),
+                                    [&qs](const LogEntry *entry) {
+                                        return entry->_time >= qs._since;
+                                    }) -
+                       chunk.begin();
+        if (shards.empty()) {
+            replayChunk(qs, chunk, index, only_update, split);
+        } else {
+            replayChunkInShards(qs, shards, chunk, index, only_update, split,
+                                !more);
+        }
+        only_update = only_update && split == chunk.size();
+    }
 
-    while (LogEntry *entry = getNextLogentry()) {
-        if (_abort_query) {
-            break;
+    // Create final reports
+    if (shards.empty() && !qs._abort_query) {
+        finishAll(qs, index);
+    }
+}
+
+// Replays a chunk of entries, the first one having the given index. If the
+// replay only updates the states so far, the query timeframe starts at the
+// entry with the index split within the chunk.
+void TableStateHistory::replayChunk(QueryState &qs,
+                                    const std::vector<const LogEntry *> &chunk,
+                                    size_t first_index, bool only_update,
+                                    size_t split) const {
+    for (size_t i = 0; i < chunk.size() && !qs._abort_query; ++i) {
+        if (only_update && i == split) {
+            startTimeframe(qs);
+            only_update = false;
         }
+        qs._entry_index = first_index + i;
+        replay(qs, chunk[i], only_update);
+    }
+}
 
-        if (entry->_time >= _until) {
-            getPreviousLogentry();
-            break;
+// Every shard replays the whole chunk, skipping the hosts and services of the
+// other shards. Only entries without a host or service, like timeperiod
+// transitions, affect all shards. A chunk at the end of the timeframe is
+// followed by the final reports. The pending rows of all shards are output
+// after each chunk, so they never need more memory than a single chunk.
+void TableStateHistory::replayChunkInShards(
+    QueryState &qs, std::vector<std::unique_ptr<QueryState>> &shards,
+    const std::vector<const LogEntry *> &chunk, size_t first_index,
+    bool only_update, size_t split, bool finish_all) {
+    auto replay_shard = [&](QueryState &shard) {
+        replayChunk(shard, chunk, first_index, only_update, split);
+        if (finish_all) {
+            finishAll(shard, first_index + chunk.size());
         }
-        if (only_update && entry->_time >= _since) {
-            // Reached start of query timeframe. From now on let's produce real
-            // output. Update _from time of every state entry
-            for (auto &it_hst : state_info) {
-                it_hst.second->_from = _since;
-                it_hst.second->_until = _since;
+    };
+    std::vector<std::future<void>> replayed;
+    for (size_t i = 1; i < shards.size(); ++i) {
+        auto task = std::make_shared<std::packaged_task<void()>>(
+            [&replay_shard, &shard = *shards[i]] { replay_shard(shard); });
+        replayed.push_back(task->get_future());
+        _shard_replayers.submit([task] { (*task)(); });
+    }
+    try {
+        replay_shard(*shards[0]);
+    } catch (...) {
+        for (auto &f : replayed) {
+            f.wait();
+        }
+        throw;
+    }
+    for (auto &f : replayed) {
+        f.get();
+    }
+    outputPendingRows(qs, shards);
+}
+
+// static
+void TableStateHistory::outputPendingRows(
+    QueryState &qs, std::vector<std::unique_ptr<QueryState>> &shards) {
+    auto before = [](const PendingRow &r1, const PendingRow &r2) {
+        return r1._entry_index != r2._entry_index
+                   ? r1._entry_index < r2._entry_index
+                   : std::less<HostServiceKey>()(r1._order_key, r2._order_key);
+    };
+    std::vector<size_t> next(shards.size());
+    while (!qs._abort_query) {
+        PendingRow *row = nullptr;
+        size_t shard = 0;
+        for (size_t i = 0; i < shards.size(); ++i) {
+            auto &pending = shards[i]->_pending;
+            if (next[i] < pending.size() &&
+                (row == nullptr || before(pending[next[i]], *row))) {
+                row = &pending[next[i]];
+                shard = i;
             }
-            only_update = false;
         }
+        if (row == nullptr) {
+            break;
+        }
+        ++next[shard];
+        qs._abort_query = !qs.output(&row->_state);
+    }
+    for (auto &shard : shards) {
+        shard->_pending.clear();
+    }
+}
 
-        if (in_nagios_initial_states &&
-            !(entry->_type == LogEntryType::state_service_initial ||
-              entry->_type == LogEntryType::state_host_initial)) {
-            // Set still unknown hosts / services to unmonitored
-            for (auto &it_hst : state_info) {
-                HostServiceState *hst = it_hst.second;
-                if (hst->_may_no_longer_exist) {
-                    hst->_has_vanished = true;
-                }
+void TableStateHistory::replay(QueryState &qs, const LogEntry *entry,
+                               bool only_update) const {
+    qs._entry_time = entry->_time;
+    qs._order_key = nullptr;
+    auto &state_info = qs._states._state_info;
+    if (qs._states._in_nagios_initial_states &&
+        !(entry->_type == LogEntryType::state_service_initial ||
+          entry->_type == LogEntryType::state_host_initial)) {
+        // Set still unknown hosts / services to unmonitored
+        for (auto &it_hst : state_info) {
+            HostServiceState *hst = it_hst.second;
+            if (hst->_may_no_longer_exist) {
+                hst->_has_vanished = true;
             }
-            in_nagios_initial_states = false;
         }
+        qs._states._in_nagios_initial_states = false;
+    }
 
-        HostServiceKey key = nullptr;
-        bool is_service = false;
-        switch (entry->_type) {
-            case LogEntryType::none:
-            case LogEntryType::core_starting:
-            case LogEntryType::core_stopping:
-            case LogEntryType::log_version:
-            case LogEntryType::acknowledge_alert_host:
-            case LogEntryType::acknowledge_alert_service:
-                break;
-            case LogEntryType::alert_service:
-            case LogEntryType::state_service:
-            case LogEntryType::state_service_initial:
-            case LogEntryType::downtime_alert_service:
-            case LogEntryType::flapping_service:
-                key = entry->_service;
-                is_service = true;
-            // fall-through
-            case LogEntryType::alert_host:
-            case LogEntryType::state_host:
-            case LogEntryType::state_host_initial:
-            case LogEntryType::downtime_alert_host:
-            case LogEntryType::flapping_host: {
-                if (!is_service) {
-                    key = entry->_host;
-                }
+    entry->parseFields(core(), _log_cache);
+    HostServiceKey key = nullptr;
+    bool is_service = false;
+    switch (entry->_type) {
+        case LogEntryType::none:
+        case LogEntryType::core_starting:
+        case LogEntryType::core_stopping:
+        case LogEntryType::log_version:
+        case LogEntryType::acknowledge_alert_host:
+        case LogEntryType::acknowledge_alert_service:
+            break;
+        case LogEntryType::alert_service:
+        case LogEntryType::state_service:
+        case LogEntryType::state_service_initial:
+        case LogEntryType::downtime_alert_service:
+        case LogEntryType::flapping_service:
+            key = entry->_service;
+            is_service = true;
+        // fall-through
+        case LogEntryType::alert_host:
+        case LogEntryType::state_host:
+        case LogEntryType::state_host_initial:
+        case LogEntryType::downtime_alert_host:
+        case LogEntryType::flapping_host: {
+            if (!is_service) {
+                key = entry->_host;
+            }
 
-                if (key == nullptr) {
-                    continue;
-                }
+            if (key == nullptr) {
+                return;
+            }
 
-                if (object_blacklist.find(key) != object_blacklist.end()) {
-                    // Host/Service is not needed for this query and has already
-                    // been filtered out.
-                    continue;
-                }
+            if (qs._num_shards > 1 &&
+                shardOf(entry->_host, qs._num_shards) != qs._shard) {
+                return;
+            }
+
+            if (qs._object_blacklist.find(key) != qs._object_blacklist.end()) {
+                // Host/Service is not needed for this query and has already
+                // been filtered out.
+                return;
+            }
 
-                // Find state object for this host/service
-                HostServiceState *state;
-                auto it_hst = state_info.find(key);
-                if (it_hst == state_info.end()) {
-                    // Create state object that we also need for filtering right
-                    // now
-                    state = new HostServiceState();
-                    state->_is_host = entry->_svc_desc.empty();
-                    state->_host = entry->_host;
-                    state->_service = entry->_service;
+            // Find state object for this host/service
+            HostServiceState *state;
+            auto it_hst = state_info.find(key);
+            if (it_hst == state_info.end()) {
+                // Create state object that we also need for filtering right
+                // now
+                state = qs._states._arena.allocate();
+                state->_is_host = entry->serviceDescription().empty();
+                state->_host = entry->_host;
+                state->_service = entry->_service;
 #ifdef CMC
-                    state->_host_name = entry->_host->name();
-                    state->_service_description = entry->_service == nullptr
-                                                      ? ""
-                                                      : entry->_service->name();
+                state->_host_name = entry->_host->name();
+                state->_service_description =
+                    entry->_service == nullptr ? "" : entry->_service->name();
 #else
-                    state->_host_name = entry->_host->name;
-                    state->_service_description =
-                        entry->_service == nullptr
-                            ? ""
-                            : entry->_service->description;
+                state->_host_name = entry->_host->name;
+                state->_service_description =
+                    entry->_service == nullptr ? ""
+                                               : entry->_service->description;
 #endif
 
-                    // No state found. Now check if this host/services is
-                    // filtered out.  Note: we currently do not filter out hosts
-                    // since they might be needed for service states
-                    if (!entry->_svc_desc.empty()) {
-                        if (!object_filter->accepts(Row(state),
-                                                    query->authUser(),
-                                                    query->timezoneOffset())) {
-                            object_blacklist.insert(key);
-                            delete state;
-                            continue;
-                        }
+                // No state found. Now check if this host/services is filtered
+                // out.  Note: we currently do not filter out hosts since they
+                // might be needed for service states
+                if (!entry->serviceDescription().empty() &&
+                    qs._object_filter != nullptr) {
+                    if (!qs._object_filter->accepts(
+                            Row(state), qs._query->authUser(),
+                            qs._query->timezoneOffset())) {
+                        qs._object_blacklist.insert(key);
+                        qs._states._arena.releaseLast();
+                        return;
                     }
+                }
 
-                    // Host/Service relations
-                    if (state->_is_host) {
-                        for (auto &it_inh : state_info) {
-                            if (it_inh.second->_host == state->_host) {
-                                state->_services.push_back(it_inh.second);
-                            }
-                        }
-                    } else {
-                        auto it_inh = state_info.find(state->_host);
-                        if (it_inh != state_info.end()) {
-                            it_inh->second->_services.push_back(state);
+                // Host/Service relations
+                if (state->_is_host) {
+                    for (auto &it_inh : state_info) {
+                        if (it_inh.second->_host == state->_host) {
+                            state->_services.push_back(it_inh.second);
                         }
                     }
+                } else {
+                    auto it_inh = state_info.find(state->_host);
+                    if (it_inh != state_info.end()) {
+                        it_inh->second->_services.push_back(state);
+                    }
+                }
 
-                    // Store this state object for tracking state transitions
-                    state_info.emplace(key, state);
-                    state->_from = _since;
+                // Store this state object for tracking state transitions
+                state_info.emplace(key, state);
+                state->_from = qs._since;
 
-                    // Get notification period of host/service
-                    // If this host/service is no longer availabe in nagios ->
-                    // set to ""
-                    if (state->_service != nullptr) {
+                // Get notification period of host/service
+                // If this host/service is no longer availabe in nagios -> set
+                // to ""
+                if (state->_service != nullptr) {
 #ifdef CMC
-                        state->_notification_period =
-                            state->_service->notificationPeriod()->name();
+                    state->_notification_period =
+                        state->_service->notificationPeriod()->name();
 #else
-                        auto np = state->_service->notification_period;
-                        state->_notification_period = np == nullptr ? "" : np;
+                    auto np = state->_service->notification_period;
+                    state->_notification_period = np == nullptr ? "" : np;
 #endif
-                    } else if (state->_host != nullptr) {
+                } else if (state->_host != nullptr) {
 #ifdef CMC
-                        state->_notification_period =
-                            state->_host->notificationPeriod()->name();
+                    state->_notification_period =
+                        state->_host->notificationPeriod()->name();
 #else
-                        auto np = state->_host->notification_period;
-                        state->_notification_period = np == nullptr ? "" : np;
+                    auto np = state->_host->notification_period;
+                    state->_notification_period = np == nullptr ? "" : np;
 #endif
-                    } else {
-                        state->_notification_period = "";
-                    }
+                } else {
+                    state->_notification_period = "";
+                }
 
-                    // Same for service period. For Nagios this is a bit
-                    // different, since this is no native field but just a
-                    // custom variable
-                    if (state->_service != nullptr) {
+                // Same for service period. For Nagios this is a bit different,
+                // since this is no native field but just a custom variable
+                if (state->_service != nullptr) {
 #ifdef CMC
-                        state->_service_period =
-                            state->_service->servicePeriod()->name();
+                    state->_service_period =
+                        state->_service->servicePeriod()->name();
 #else
-                        state->_service_period =
-                            getCustomVariable(state->_service->custom_variables,
-                                              "SERVICE_PERIOD");
+                    state->_service_period = getCustomVariable(
+                        state->_service->custom_variables, "SERVICE_PERIOD");
 #endif
-                    } else if (state->_host != nullptr) {
+                } else if (state->_host != nullptr) {
 #ifdef CMC
-                        state->_service_period =
-                            state->_host->servicePeriod()->name();
+                    state->_service_period =
+                        state->_host->servicePeriod()->name();
 #else
-                        state->_service_period = getCustomVariable(
-                            state->_host->custom_variables, "SERVICE_PERIOD");
+                    state->_service_period = getCustomVariable(
+                        state->_host->custom_variables, "SERVICE_PERIOD");
 #endif
-                    } else {
-                        state->_service_period = "";
-                    }
-
-                    // Determine initial in_notification_period status
-                    auto tmp_period =
-                        _notification_periods.find(state->_notification_period);
-                    if (tmp_period != _notification_periods.end()) {
-                        state->_in_notification_period = tmp_period->second;
-                    } else {
-                        state->_in_notification_period = 1;
-                    }
+                } else {
+                    state->_service_period = "";
+                }
 
-                    // Same for service period
-                    tmp_period =
-                        _notification_periods.find(state->_service_period);
-                    if (tmp_period != _notification_periods.end()) {
-                        state->_in_service_period = tmp_period->second;
-                    } else {
-                        state->_in_service_period = 1;
-                    }
+                // Determine initial in_notification_period status
+                auto &notification_periods = qs._states._notification_periods;
+                auto tmp_period =
+                    notification_periods.find(state->_notification_period);
+                if (tmp_period != notification_periods.end()) {
+                    state->_in_notification_period = tmp_period->second;
+                } else {
+                    state->_in_notification_period = 1;
+                }
 
-                    // If this key is a service try to find its host and apply
-                    // its _in_host_downtime and _host_down parameters
-                    if (!state->_is_host) {
-                        auto my_host = state_info.find(state->_host);
-                        if (my_host != state_info.end()) {
-                            state->_in_host_downtime =
-                                my_host->second->_in_host_downtime;
-                            state->_host_down = my_host->second->_host_down;
-                        }
-                    }
+                // Same for service period
+                tmp_period = notification_periods.find(state->_service_period);
+                if (tmp_period != notification_periods.end()) {
+                    state->_in_service_period = tmp_period->second;
+                } else {
+                    state->_in_service_period = 1;
+                }
 
-                    // Log UNMONITORED state if this host or service just
-                    // appeared within the query timeframe
-                    // It gets a grace period of ten minutes (nagios startup)
-                    if (!only_update && entry->_time - _since > 60 * 10) {
-                        state->_debug_info = "UNMONITORED ";
-                        state->_state = -1;
+                // If this key is a service try to find its host and apply its
+                // _in_host_downtime and _host_down parameters
+                if (!state->_is_host) {
+                    auto my_host = state_info.find(state->_host);
+                    if (my_host != state_info.end()) {
+                        state->_in_host_downtime =
+                            my_host->second->_in_host_downtime;
+                        state->_host_down = my_host->second->_host_down;
                     }
-                } else {
-                    state = it_hst->second;
                 }
 
-                int state_changed =
-                    updateHostServiceState(query, entry, state, only_update);
-                // Host downtime or state changes also affect its services
-                if (entry->_type == LogEntryType::alert_host ||
-                    entry->_type == LogEntryType::state_host ||
-                    entry->_type == LogEntryType::downtime_alert_host) {
-                    if (state_changed != 0) {
-                        for (auto &_service : state->_services) {
-                            updateHostServiceState(query, entry, _service,
-                                                   only_update);
-                        }
+                // Log UNMONITORED state if this host or service just appeared
+                // within the query timeframe
+                // It gets a grace period of ten minutes (nagios startup)
+                if (!only_update && entry->_time - qs._since > 60 * 10) {
+                    state->_debug_info = "UNMONITORED ";
+                    state->_state = -1;
+                    if (qs._cache != nullptr) {
+                        qs._cache->addAppearance(*state, entry->_time);
                     }
                 }
-                break;
+            } else {
+                state = it_hst->second;
             }
-            case LogEntryType::timeperiod_transition: {
-                try {
-                    TimeperiodTransition tpt(entry->_options);
-                    _notification_periods[tpt.name()] = tpt.to();
-                    for (auto &it_hst : state_info) {
-                        updateHostServiceState(query, entry, it_hst.second,
+
+            int state_changed =
+                updateHostServiceState(qs, entry, state, only_update);
+            // Host downtime or state changes also affect its services
+            if (entry->_type == LogEntryType::alert_host ||
+                entry->_type == LogEntryType::state_host ||
+                entry->_type == LogEntryType::downtime_alert_host) {
+                if (state_changed != 0) {
+                    for (auto &_service : state->_services) {
+                        updateHostServiceState(qs, entry, _service,
                                                only_update);
                     }
-                } catch (const std::logic_error &e) {
-                    Warning(logger())
-                        << "Error: Invalid syntax of TIMEPERIOD TRANSITION: "
-                        << entry->_complete;
                 }
-                break;
             }
-            case LogEntryType::log_initial_states: {
-                // This feature is only available if log_initial_states is set
-                // to 1. If log_initial_states is set, each nagios startup logs
-                // the initial states of all known hosts and services. Therefore
-                // we can detect if a host is no longer available after a nagios
-                // startup. If it still exists an INITIAL HOST/SERVICE state
-                // entry will follow up shortly.
+            break;
+        }
+        case LogEntryType::timeperiod_transition: {
+            try {
+                TimeperiodTransition tpt(std::string(entry->options()));
+                qs._states._notification_periods[tpt.name()] = tpt.to();
+                qs._transition = &tpt;
                 for (auto &it_hst : state_info) {
-                    if (!it_hst.second->_has_vanished) {
-                        it_hst.second->_last_known_time = entry->_time;
-                        it_hst.second->_may_no_longer_exist = true;
-                    }
+                    qs._order_key = it_hst.first;
+                    updateHostServiceState(qs, entry, it_hst.second,
+                                           only_update);
+                }
+                qs._transition = nullptr;
+            } catch (const std::logic_error &e) {
+                Warning(logger())
+                    << "Error: Invalid syntax of TIMEPERIOD TRANSITION: "
+                    << entry->message();
+            }
+            break;
+        }
+        case LogEntryType::log_initial_states: {
+            // This feature is only available if log_initial_states is set to
+            // 1. If log_initial_states is set, each nagios startup logs the
+            // initial states of all known hosts and services. Therefore we can
+            // detect if a host is no longer available after a nagios startup.
+            // If it still exists an INITIAL HOST/SERVICE state entry will
+            // follow up shortly.
+            for (auto &it_hst : state_info) {
+                if (!it_hst.second->_has_vanished) {
+                    it_hst.second->_last_known_time = entry->_time;
+                    it_hst.second->_may_no_longer_exist = true;
                 }
-                in_nagios_initial_states = true;
-                break;
             }
+            qs._states._in_nagios_initial_states = true;
+            break;
         }
     }
+}
 
-    // Create final reports
-    auto it_hst = state_info.begin();
-    if (!_abort_query) {
-        while (it_hst != state_info.end()) {
-            HostServiceState *hst = it_hst->second;
+// Reached start of query timeframe. From now on let's produce real output.
+// Update _from time of every state entry
 
-            // No trace since the last two nagios startup -> host/service has
-            // vanished
-            if (hst->_may_no_longer_exist) {
-                // Log last known state up to nagios restart
-                hst->_time = hst->_last_known_time;
-                hst->_until = hst->_last_known_time;
-                process(query, hst);
+// static
+void TableStateHistory::startTimeframe(QueryState &qs) {
+    for (auto &it_hst : qs._states._state_info) {
+        it_hst.second->_from = qs._since;
+        it_hst.second->_until = qs._since;
+    }
+}
+
+// Create final reports, the index being the one after the last entry
+
+// static
+void TableStateHistory::finishAll(QueryState &qs, size_t index) {
+    qs._entry_index = index;
+    for (auto &it_hst : qs._states._state_info) {
+        qs._order_key = it_hst.first;
+        finish(qs, it_hst.second);
+    }
+}
+
+// static
+void TableStateHistory::finish(QueryState &qs, HostServiceState *hst) {
+    // No trace since the last two nagios startup -> host/service has vanished
+    if (hst->_may_no_longer_exist) {
+        // Log last known state up to nagios restart
+        hst->_time = hst->_last_known_time;
+        hst->_until = hst->_last_known_time;
+        process(qs, hst);
+
+        // Set absent state
+        hst->_state = -1;
+        hst->_debug_info = "UNMONITORED";
+        hst->_log_output = "";
+    }
 
-                // Set absent state
-                hst->_state = -1;
-                hst->_debug_info = "UNMONITORED";
-                hst->_log_output = "";
+    hst->_time = qs._until - 1;
+    hst->_until = hst->_time;
+
+    process(qs, hst);
+}
+
+#ifndef CMC
+TableStateHistory::~TableStateHistory() { _shutting_down = true; }
+
+// The history starts with the logfile containing the start of the window of
+// the sums in the cache. The logfiles are replayed one after the other, so
+// only the entries of one of them are kept alive at a time, and the rows are
+// dropped as soon as they have left their window.
+void TableStateHistory::buildCache() {
+    if (_cache) {
+        return;  // queued by a query just before the last build had finished
+    }
+    auto logfiles = _log_cache->logfiles();
+    if (logfiles->empty()) {
+        return;
+    }
+    auto it = logfiles->upper_bound(time(nullptr) -
+                                    StateHistoryCache::max_rollup_age);
+    if (it != logfiles->begin()) {
+        --it;
+    }
+    auto cache = std::make_unique<StateHistoryCache>(it->first);
+    for (; it != logfiles->end(); ++it) {
+        auto entries = it->second->readEntriesFor(classmask_statehist);
+        if (!replayIntoCache(*cache, {{it->first, entries}})) {
+            return;
+        }
+        cache->dropExpired(time(nullptr));
+    }
+    Informational(logger()) << "statehist cache built with "
+                            << cache->numRows() << " rows for "
+                            << cache->states()._state_info.size()
+                            << " hosts and services";
+    auto bytes = cache->bytes();
+    {
+        std::unique_lock<std::shared_mutex> ul(_cache_lock);
+        _cache = std::move(cache);
+    }
+    _log_cache->setDerivedBytes(bytes);
+}
+
+// Replays the entries which have been added to the log since the last update
+// and drops the rows and sums which have left their windows. The entries are
+// collected before taking the lock, so the queries are only blocked by the
+// replay.
+void TableStateHistory::updateCache() {
+    if (!_cache) {
+        return;
+    }
+    auto position = _cache->position();
+    auto logfiles = _log_cache->logfiles();
+    LogfilesToReplay to_replay;
+    for (auto it = logfiles->lower_bound(position._logfile);
+         it != logfiles->end(); ++it) {
+        to_replay.emplace_back(
+            it->first, it->second->readEntriesFor(classmask_statehist));
+    }
+    auto is_new = [&position](const auto &logfile) {
+        if (logfile.first != position._logfile) {
+            return true;
+        }
+        const auto &entries = *logfile.second;
+        return !entries.empty() &&
+               ((entries.end() - 1)->_time != position._time ||
+                (entries.end() - 1)->_lineno != position._lineno);
+    };
+    auto now = time(nullptr);
+    if (std::none_of(to_replay.begin(), to_replay.end(), is_new) &&
+        !_cache->hasExpired(now)) {
+        return;
+    }
+    size_t bytes = 0;
+    {
+        std::unique_lock<std::shared_mutex> ul(_cache_lock);
+        replayIntoCache(*_cache, to_replay);
+        _cache->dropExpired(now);
+        bytes = _cache->bytes();
+    }
+    _log_cache->setDerivedBytes(bytes);
+}
+
+// Returns true if the cache has been built. Otherwise its build is started,
+// unless it is running already: A build which has been cut short or has found
+// no logfiles is retried by the next query.
+bool TableStateHistory::cacheIsBuilt() {
+    {
+        std::shared_lock<std::shared_mutex> sl(_cache_lock);
+        if (_cache) {
+            return true;
+        }
+    }
+    std::lock_guard<std::mutex> lg(_update_lock);
+    if (!_cache_building) {
+        _cache_building = true;
+        _cache_builder.submit([this] {
+            buildCache();
+            std::lock_guard<std::mutex> lg(_update_lock);
+            _cache_building = false;
+        });
+    }
+    return false;
+}
+
+// Waits until the cache has seen all entries written before. Queries arriving
+// before an update has started share it.
+void TableStateHistory::waitForCache() {
+    std::shared_future<void> update;
+    {
+        std::lock_guard<std::mutex> lg(_update_lock);
+        if (!_queued_update.valid()) {
+            auto task = std::make_shared<std::packaged_task<void()>>([this] {
+                {
+                    std::lock_guard<std::mutex> lg(_update_lock);
+                    _queued_update = std::shared_future<void>();
+                }
+                updateCache();
+            });
+            _queued_update = task->get_future().share();
+            _cache_builder.submit([task] { (*task)(); });
+        }
+        update = _queued_update;
+    }
+    update.wait();
+}
+
+// Replays the entries after the position of the cache, with the output going
+// to the cache. Returns false if this has been cut short by our destruction.
+bool TableStateHistory::replayIntoCache(StateHistoryCache &cache,
+                                        const LogfilesToReplay &logfiles) {
+    QueryState qs(nullptr, nullptr);
+    qs._cache = &cache;
+    qs._since = cache.since();
+    qs._query_timeframe = 1;  // the queries compute the durations
+    qs._states = std::move(cache.states());
+    auto position = cache.position();
+    bool complete = true;
+    for (auto it = logfiles.begin(); complete && it != logfiles.end(); ++it) {
+        if (it->first < position._logfile) {
+            continue;
+        }
+        if (it->first != position._logfile) {
+            cache.addCheckpoint(it->first, qs._states);
+        }
+        const auto &entries = *it->second;
+        auto it_entries = it->first == position._logfile
+                              ? entries.upperBound(position._time - 1)
+                              : entries.begin();
+        for (; it_entries != entries.end(); ++it_entries) {
+            if (_shutting_down) {
+                complete = false;
+                break;
+            }
+            if (it->first == position._logfile &&
+                it_entries->_time == position._time &&
+                it_entries->_lineno <= position._lineno) {
+                continue;
             }
+            replay(qs, &*it_entries, false);
+            position = {it->first, it_entries->_time, it_entries->_lineno};
+        }
+    }
+    cache.states() = std::move(qs._states);
+    cache.setPosition(position);
+    cache.rollUp(position._time);
+    return complete;
+}
+
+// Once the cache has been built, queries starting within its window get their
+// rows from the cache, waiting for it to be brought up to date if needed.
+// Until then, they replay the log. The cache knows the history of all objects
+// from the start of its window, while a query replaying the log only knows
+// what it has seen since the start of the logfile containing its "since". The
+// core logs the current state of all objects at the start of each logfile, so
+// the states are the same, but the cache knows about downtimes, flapping and
+// timeperiods from earlier logfiles, too. Older queries always replay the
+// log, and so do those which would grant an object appearing shortly after
+// their start the grace period the cache hasn't, see replay(). Queries which
+// only sum up durations may start before the rows of the cache, see below.
+bool TableStateHistory::answerQueryFromCache(QueryState &qs) {
+    bool only_sums =
+        qs._query->onlySums(isDurationColumn, isObjectColumn) &&
+        std::all_of(qs._query->allColumns().begin(),
+                    qs._query->allColumns().end(), [](const auto &c) {
+                        return isDurationColumn(*c) || isObjectColumn(*c) ||
+                               c->name() == "time";
+                    });
+    auto max_age = only_sums ? StateHistoryCache::max_rollup_age
+                             : StateHistoryCache::max_age;
+    if (qs._since < time(nullptr) - max_age || !cacheIsBuilt()) {
+        return false;
+    }
+    waitForCache();
+    std::shared_lock<std::shared_mutex> sl(_cache_lock);
+    if (!_cache || _cache->deniedGraceSince(qs._since)) {
+        return false;
+    }
+    const StateHistoryCache &cache = *_cache;
+    bool before_rows = !cache.keepsRowsSince(qs._since);
+    if (before_rows &&
+        (!only_sums || qs._since < cache.firstDay() ||
+         !cache.keepsRowsSince(qs._until))) {
+        return false;
+    }
+
+    // The states at the end of the timeframe: When the cache has replayed
+    // entries beyond it, replay the logfiles before it again from the last
+    // checkpoint, without any output.
+    const HostServiceStates *end_states = &cache.states();
+    auto logfiles = _log_cache->logfiles();
+    QueryState silent(nullptr, logfiles);
+    if (qs._until <= cache.position()._time) {
+        auto logfile = cache.restoreCheckpoint(qs._until, silent._states);
+        if (!logfile || logfiles->find(*logfile) == logfiles->end()) {
+            return false;
+        }
+        silent._since = cache.since();
+        silent._query_timeframe = 1;
+        for (auto it = logfiles->find(*logfile);
+             it != logfiles->end() && it->first < qs._until; ++it) {
+            auto entries = it->second->getEntriesFor(classmask_statehist);
+            for (auto it_entries = entries->begin();
+                 it_entries != entries->end() && it_entries->_time < qs._until;
+                 ++it_entries) {
+                replay(silent, &*it_entries, false);
+            }
+        }
+        end_states = &silent._states;
+    }
 
-            hst->_time = _until - 1;
-            hst->_until = hst->_time;
+    auto accepts = [&qs](const HostServiceState &hs_state) {
+        if (hs_state._is_host) {
+            return true;
+        }
+        auto object = StateHistoryCache::objectOf(hs_state);
+        return qs._object_filter->accepts(Row(&object), qs._query->authUser(),
+                                          qs._query->timezoneOffset());
+    };
+
+    // The objects of the rows, created and filtered on first use, which of
+    // them already have a row in the timeframe, and where their first row is
+    // clipped otherwise.
+    HostServiceStateArena arena;
+    std::vector<HostServiceState *> objects(cache.numObjects());
+    std::vector<bool> rejected(cache.numObjects());
+    std::vector<bool> seen(cache.numObjects());
+    std::vector<time_t> clip(cache.numObjects(), qs._since);
+    auto object_of = [&](size_t i) {
+        if (objects[i] == nullptr && !rejected[i]) {
+            if (accepts(cache.object(i))) {
+                objects[i] = arena.allocate(cache.object(i));
+            } else {
+                rejected[i] = true;
+            }
+        }
+        return objects[i];
+    };
+
+    // A query which only sums up durations gets a single row per object
+    // instead, summed up from the rollups of the whole days in its timeframe
+    // and the rows of the partial days at its start and end. The time only
+    // bounds the timeframe then, but like above, the first row of an object
+    // is clipped at the start of the timeframe, and rows with a time before
+    // it are filtered out. When the rows of the partial day at the start have
+    // been dropped already, they come from a replay of the log for that day.
+    // Its rows need not line up with the ones of the cache, which knows more
+    // history, so the replay sums up the states up to the first whole day,
+    // and the next row of each of its objects is clipped there.
+    constexpr auto day = StateHistoryCache::seconds_per_day;
+    time_t first_day =
+        std::max((qs._since + day - 1) / day * day, cache.firstDay());
+    time_t last_day = std::min(qs._until / day * day, cache.rolledUpUntil());
+    auto last_row = cache.firstRowAt(qs._until);
+    if (only_sums && (first_day < last_day || before_rows)) {
+        std::vector<StateHistoryCache::Durations> totals(cache.numObjects());
+        auto add_row = [&](size_t object, const StateHistoryCache::Row &row) {
+            if (object_of(object) == nullptr) {
+                return;
+            }
+            auto from = seen[object] ? row._from : clip[object];
+            seen[object] = true;
+            if (row._time >= qs._since) {
+                totals[object].add(row._state, row._until - from);
+            }
+        };
+        auto add_rows = [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                add_row(cache.row(i)._object, cache.row(i));
+            }
+        };
+        if (before_rows) {
+            StateHistoryCache start(qs._since);
+            replayStart(start, logfiles, first_day);
+            for (size_t i = 0; i < start.numRows(); ++i) {
+                const auto &row = start.row(i);
+                auto object = cache.findObject(start.object(row._object));
+                if (object != cache.numObjects()) {
+                    add_row(object, row);
+                }
+            }
+            for (const auto &it_hst : start.states()._state_info) {
+                auto object = cache.findObject(it_hst.first);
+                if (object == cache.numObjects() ||
+                    object_of(object) == nullptr) {
+                    continue;
+                }
+                const auto &hst = *it_hst.second;
+                totals[object].add(hst._state, first_day - hst._from);
+                seen[object] = false;
+                clip[object] = first_day;
+            }
+        } else {
+            add_rows(cache.firstRowAt(qs._since), cache.firstRowAt(first_day));
+        }
+        for (auto t = first_day; t < last_day; t += day) {
+            const auto &rollups = cache.day(t);
+            for (const auto &rollup : rollups._rollups) {
+                const auto &first = rollup._first;
+                if (object_of(first._object) == nullptr) {
+                    continue;
+                }
+                auto &total = totals[first._object];
+                total.add(rollup._durations);
+                auto from =
+                    seen[first._object] ? first._from : clip[first._object];
+                seen[first._object] = true;
+                total.add(first._state, first._from - from);
+                if (first._time < qs._since) {
+                    total.add(first._state, from - first._until);
+                }
+            }
+            for (const auto &row : rollups._backdated_rows) {
+                if (row._time < qs._since &&
+                    object_of(row._object) != nullptr) {
+                    totals[row._object].add(row._state, row._from - row._until);
+                }
+            }
+        }
+        add_rows(cache.firstRowAt(last_day), last_row);
+        for (size_t i = 0; i < totals.size() && !qs._abort_query; ++i) {
+            if (seen[i] || clip[i] != qs._since) {
+                processDurations(qs, objects[i], totals[i]);
+            }
+        }
+    } else {
+        for (size_t i = cache.firstRowAt(qs._since);
+             i < last_row && !qs._abort_query; ++i) {
+            const auto &row = cache.row(i);
+            auto *object = object_of(row._object);
+            if (object == nullptr) {
+                continue;
+            }
+            StateHistoryCache::applyRow(row, *object);
+            if (!seen[row._object]) {
+                // like the start of the query timeframe in answerQuery()
+                object->_from = qs._since;
+                seen[row._object] = true;
+            }
+            process(qs, object);
+        }
+    }
 
-            process(query, hst);
-            ++it_hst;
+    if (!qs._abort_query) {
+        for (const auto &it_hst : end_states->_state_info) {
+            if (!accepts(*it_hst.second)) {
+                continue;
+            }
+            HostServiceState hst = *it_hst.second;
+            auto i = cache.findObject(it_hst.first);
+            if (i == cache.numObjects()) {
+                hst._from = qs._since;
+            } else if (!seen[i]) {
+                hst._from = clip[i];
+            }
+            finish(qs, &hst);
         }
     }
+    return true;
+}
 
-    // Cleanup !
-    it_hst = state_info.begin();
-    while (it_hst != state_info.end()) {
-        delete it_hst->second;
-        ++it_hst;
+// Replays the log from the start of the logfile containing the start of the
+// given cache up to the given time, like a query without the cache does, with
+// the rows and the states at that time going to the cache.
+void TableStateHistory::replayStart(
+    StateHistoryCache &cache,
+    const std::shared_ptr<const logfiles_t> &logfiles, time_t until) const {
+    QueryState qs(nullptr, logfiles);
+    qs._cache = &cache;
+    qs._since = cache.since();
+    qs._query_timeframe = 1;  // the query computes the durations
+    auto it = logfiles->lower_bound(qs._since);
+    if (it != logfiles->begin()) {
+        --it;
+    }
+    bool only_update = true;
+    for (; it != logfiles->end() && it->first < until; ++it) {
+        auto entries = it->second->getEntriesFor(classmask_statehist);
+        for (auto it_entries = entries->begin();
+             it_entries != entries->end() && it_entries->_time < until;
+             ++it_entries) {
+            if (only_update && it_entries->_time >= qs._since) {
+                startTimeframe(qs);
+                only_update = false;
+            }
+            replay(qs, &*it_entries, only_update);
+        }
+    }
+    if (only_update) {
+        startTimeframe(qs);
     }
-    state_info.clear();
-    object_blacklist.clear();
+    cache.states() = std::move(qs._states);
 }
 
-int TableStateHistory::updateHostServiceState(Query *query,
+// Like process(), but for the sum of the rows of an object in the whole
+// timeframe.
+
+// static
+void TableStateHistory::processDurations(
+    QueryState &qs, HostServiceState *hs_state,
+    const StateHistoryCache::Durations &durations) {
+    auto part = [&qs](time_t duration) {
+        return static_cast<double>(duration) /
+               static_cast<double>(qs._query_timeframe);
+    };
+    hs_state->_time = qs._since;
+    hs_state->_from = qs._since;
+    hs_state->_until = qs._until - 1;
+    hs_state->_duration = durations._total;
+    hs_state->_duration_part = part(durations._total);
+    hs_state->_duration_state_UNMONITORED = durations._state[0];
+    hs_state->_duration_part_UNMONITORED = part(durations._state[0]);
+    hs_state->_duration_state_OK = durations._state[1];
+    hs_state->_duration_part_OK = part(durations._state[1]);
+    hs_state->_duration_state_WARNING = durations._state[2];
+    hs_state->_duration_part_WARNING = part(durations._state[2]);
+    hs_state->_duration_state_CRITICAL = durations._state[3];
+    hs_state->_duration_part_CRITICAL = part(durations._state[3]);
+    hs_state->_duration_state_UNKNOWN = durations._state[4];
+    hs_state->_duration_part_UNKNOWN = part(durations._state[4]);
+    qs._abort_query = !qs.output(hs_state);
+}
+#endif
+
+int TableStateHistory::updateHostServiceState(QueryState &qs,
                                               const LogEntry *entry,
                                               HostServiceState *hs_state,
-                                              const bool only_update) {
+                                              const bool only_update) const {
     int state_changed = 1;
 
     // Revive host / service if it was unmonitored
@@ -653,7 +1290,7 @@ int TableStateHistory::updateHostServiceState(Query *query,
         hs_state->_time = hs_state->_last_known_time;
         hs_state->_until = hs_state->_last_known_time;
         if (!only_update) {
-            process(query, hs_state);
+            process(qs, hs_state);
         }
 
         hs_state->_may_no_longer_exist = false;
@@ -669,9 +1306,10 @@ int TableStateHistory::updateHostServiceState(Query *query,
 
         // Apply latest notification period information and set the host_state
         // to unmonitored
+        auto &notification_periods = qs._states._notification_periods;
         auto it_status =
-            _notification_periods.find(hs_state->_notification_period);
-        if (it_status != _notification_periods.end()) {
+            notification_periods.find(hs_state->_notification_period);
+        if (it_status != notification_periods.end()) {
             hs_state->_in_notification_period = it_status->second;
         } else {
             // No notification period information available -> within
@@ -680,8 +1318,8 @@ int TableStateHistory::updateHostServiceState(Query *query,
         }
 
         // Same for service period
-        it_status = _notification_periods.find(hs_state->_service_period);
-        if (it_status != _notification_periods.end()) {
+        it_status = notification_periods.find(hs_state->_service_period);
+        if (it_status != notification_periods.end()) {
             hs_state->_in_service_period = it_status->second;
         } else {
             // No service period information available -> within service period
@@ -715,7 +1353,7 @@ int TableStateHistory::updateHostServiceState(Query *query,
             if (hs_state->_is_host) {
                 if (hs_state->_state != entry->_state) {
                     if (!only_update) {
-                        process(query, hs_state);
+                        process(qs, hs_state);
                     }
                     hs_state->_state = entry->_state;
                     hs_state->_host_down = static_cast<int>(entry->_state > 0);
@@ -726,7 +1364,7 @@ int TableStateHistory::updateHostServiceState(Query *query,
             } else if (hs_state->_host_down !=
                        static_cast<int>(entry->_state > 0)) {
                 if (!only_update) {
-                    process(query, hs_state);
+                    process(qs, hs_state);
                 }
                 hs_state->_host_down = static_cast<int>(entry->_state > 0);
                 hs_state->_debug_info = "SVC HOST STATE";
@@ -738,7 +1376,7 @@ int TableStateHistory::updateHostServiceState(Query *query,
         case LogEntryType::alert_service: {
             if (hs_state->_state != entry->_state) {
                 if (!only_update) {
-                    process(query, hs_state);
+                    process(qs, hs_state);
                 }
                 hs_state->_debug_info = "SVC ALERT";
                 hs_state->_state = entry->_state;
@@ -747,11 +1385,11 @@ int TableStateHistory::updateHostServiceState(Query *query,
         }
         case LogEntryType::downtime_alert_host: {
             int downtime_active =
-                mk::starts_with(entry->_state_type, "STARTED") ? 1 : 0;
+                entry->stateType().compare(0, 7, "STARTED") == 0 ? 1 : 0;
 
             if (hs_state->_in_host_downtime != downtime_active) {
                 if (!only_update) {
-                    process(query, hs_state);
+                    process(qs, hs_state);
                 }
                 hs_state->_debug_info =
                     hs_state->_is_host ? "HOST DOWNTIME" : "SVC HOST DOWNTIME";
@@ -766,10 +1404,10 @@ int TableStateHistory::updateHostServiceState(Query *query,
         }
         case LogEntryType::downtime_alert_service: {
             int downtime_active =
-                mk::starts_with(entry->_state_type, "STARTED") ? 1 : 0;
+                entry->stateType().compare(0, 7, "STARTED") == 0 ? 1 : 0;
             if (hs_state->_in_downtime != downtime_active) {
                 if (!only_update) {
-                    process(query, hs_state);
+                    process(qs, hs_state);
                 }
                 hs_state->_debug_info = "DOWNTIME SERVICE";
                 hs_state->_in_downtime = downtime_active;
@@ -779,10 +1417,10 @@ int TableStateHistory::updateHostServiceState(Query *query,
         case LogEntryType::flapping_host:
         case LogEntryType::flapping_service: {
             int flapping_active =
-                mk::starts_with(entry->_state_type, "STARTED") ? 1 : 0;
+                entry->stateType().compare(0, 7, "STARTED") == 0 ? 1 : 0;
             if (hs_state->_is_flapping != flapping_active) {
                 if (!only_update) {
-                    process(query, hs_state);
+                    process(qs, hs_state);
                 }
                 hs_state->_debug_info = "FLAPPING ";
                 hs_state->_is_flapping = flapping_active;
@@ -792,35 +1430,29 @@ int TableStateHistory::updateHostServiceState(Query *query,
             break;
         }
         case LogEntryType::timeperiod_transition: {
-            try {
-                TimeperiodTransition tpt(entry->_options);
-                // if no _host pointer is available the initial status of
-                // _in_notification_period (1) never changes
-                if (hs_state->_host != nullptr &&
-                    tpt.name() == hs_state->_notification_period) {
-                    if (tpt.to() != hs_state->_in_notification_period) {
-                        if (!only_update) {
-                            process(query, hs_state);
-                        }
-                        hs_state->_debug_info = "TIMEPERIOD ";
-                        hs_state->_in_notification_period = tpt.to();
+            const TimeperiodTransition &tpt = *qs._transition;
+            // if no _host pointer is available the initial status of
+            // _in_notification_period (1) never changes
+            if (hs_state->_host != nullptr &&
+                tpt.name() == hs_state->_notification_period) {
+                if (tpt.to() != hs_state->_in_notification_period) {
+                    if (!only_update) {
+                        process(qs, hs_state);
                     }
+                    hs_state->_debug_info = "TIMEPERIOD ";
+                    hs_state->_in_notification_period = tpt.to();
                 }
-                // same for service period
-                if (hs_state->_host != nullptr &&
-                    tpt.name() == hs_state->_service_period) {
-                    if (tpt.to() != hs_state->_in_service_period) {
-                        if (!only_update) {
-                            process(query, hs_state);
-                        }
-                        hs_state->_debug_info = "TIMEPERIOD ";
-                        hs_state->_in_service_period = tpt.to();
+            }
+            // same for service period
+            if (hs_state->_host != nullptr &&
+                tpt.name() == hs_state->_service_period) {
+                if (tpt.to() != hs_state->_in_service_period) {
+                    if (!only_update) {
+                        process(qs, hs_state);
                     }
+                    hs_state->_debug_info = "TIMEPERIOD ";
+                    hs_state->_in_service_period = tpt.to();
                 }
-            } catch (const std::logic_error &e) {
-                Warning(logger())
-                    << "Error: Invalid syntax of TIMEPERIOD TRANSITION: "
-                    << entry->_complete;
             }
             break;
         }
@@ -829,20 +1461,21 @@ int TableStateHistory::updateHostServiceState(Query *query,
     if (entry->_type != LogEntryType::timeperiod_transition) {
         if ((entry->_type == LogEntryType::state_host_initial ||
              entry->_type == LogEntryType::state_service_initial) &&
-            entry->_check_output == "(null)") {
+            entry->checkOutput() == "(null)") {
             hs_state->_log_output = "";
         } else {
-            hs_state->_log_output = entry->_check_output;
+            hs_state->_log_output = entry->checkOutput();
         }
     }
 
     return state_changed;
 }
 
-void TableStateHistory::process(Query *query, HostServiceState *hs_state) {
+// static
+void TableStateHistory::process(QueryState &qs, HostServiceState *hs_state) {
     hs_state->_duration = hs_state->_until - hs_state->_from;
     hs_state->_duration_part = static_cast<double>(hs_state->_duration) /
-                               static_cast<double>(_query_timeframe);
+                               static_cast<double>(qs._query_timeframe);
 
     hs_state->_duration_state_UNMONITORED = 0;
     hs_state->_duration_part_UNMONITORED = 0;
@@ -885,7 +1518,7 @@ void TableStateHistory::process(Query *query, HostServiceState *hs_state) {
     }
 
     // if (hs_state->_duration > 0)
-    _abort_query = !query->processDataset(Row(hs_state));
+    qs._abort_query = !qs.output(hs_state);
 
     hs_state->_from = hs_state->_until;
 }
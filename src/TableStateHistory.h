@@ -26,29 +26,44 @@
 #define TableStateHistory_h
 
 #include "config.h"  // IWYU pragma: keep
-#include <map>
+#include <cstddef>
+#include <ctime>
 #include <memory>
 #include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "HostServiceState.h"
 #include "LogCache.h"
+#include "LogPrefetcher.h"
 #include "Logfile.h"
+#include "LogfileEntries.h"
 #include "Table.h"
 class Column;
 class Filter;
-class HostServiceState;
 class LogEntry;
 class MonitoringCore;
 class Query;
 class Row;
+class StateHistoryCache;
 
 #ifdef CMC
 #include "cmc.h"
 #else
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include "StateHistoryCache.h"
 #include "contact_fwd.h"
 #endif
 
 class TableStateHistory : public Table {
 public:
     TableStateHistory(MonitoringCore *mc, LogCache *log_cache);
+#ifndef CMC
+    ~TableStateHistory() override;
+#endif
 
     [[nodiscard]] std::string name() const override;
     [[nodiscard]] std::string namePrefix() const override;
@@ -58,29 +73,121 @@ public:
         std::string colname) const override;
     static std::unique_ptr<Filter> createPartialFilter(const Query &query);
 
-protected:
-    bool _abort_query;
-
 private:
+    class TimeperiodTransition;
+
+    // A row of a replay in shards, with what orders it like the output of a
+    // sequential replay: The index of the entry which has produced it, and for
+    // entries affecting all objects, the key of its object.
+    struct PendingRow {
+        size_t _entry_index;
+        HostServiceKey _order_key;
+        HostServiceState _state;
+    };
+
+    // Everything a single query needs, so that several queries can run
+    // concurrently on different client threads. Without a query, the rows
+    // are added to a StateHistoryCache instead, if any. In a replay in
+    // shards, each shard has its own state, and the rows are kept pending.
+    class QueryState {
+    public:
+        QueryState(Query *query, std::shared_ptr<const logfiles_t> logfiles);
+
+        Query *const _query;
+        StateHistoryCache *_cache;
+        Filter *_object_filter;  // nullptr: all objects are needed
+        int _query_timeframe;
+        int _since;
+        int _until;
+        bool _abort_query;
+
+        // Keep track of the historic state of services/hosts here
+        HostServiceStates _states;
+
+        // Store hosts/services that we have filtered out here
+        std::unordered_set<HostServiceKey> _object_blacklist;
+
+        // The time of the entry being replayed
+        time_t _entry_time;
+
+        // In a replay in shards, only the hosts of the given shard and their
+        // services are replayed, see PendingRow for the rest.
+        size_t _shard;
+        size_t _num_shards;
+        size_t _entry_index;
+        HostServiceKey _order_key;
+        std::vector<PendingRow> _pending;
+
+        // The timeperiod transition being replayed, parsed only once for all
+        // hosts and services
+        const TimeperiodTransition *_transition;
+
+        // Helper functions to traverse through logfiles
+        std::shared_ptr<const logfiles_t> _logfiles;
+        logfiles_t::const_iterator _it_logs;
+        std::shared_ptr<const LogfileEntries> _entries;
+        LogfileEntries::const_iterator _it_entries;
+
+        const LogEntry *getNextLogentry();
+        bool getNextChunk(
+            std::vector<const LogEntry *> &chunk,
+            std::vector<std::shared_ptr<const LogfileEntries>> &chunk_entries);
+        bool output(HostServiceState *hs_state);
+    };
+
     LogCache *_log_cache;
+    // Replays all shards but the first one, which the query does itself.
+    LogPrefetcher _shard_replayers;
 
-    int _query_timeframe;
-    int _since;
-    int _until;
+#ifndef CMC
+    // The entries of some logfiles, identified by their start.
+    using LogfilesToReplay =
+        std::vector<std::pair<time_t, std::shared_ptr<const LogfileEntries>>>;
 
-    // Notification periods information, name: active(1)/inactive(0)
-    std::map<std::string, int> _notification_periods;
+    // Built on a background thread after the first query, and brought up to
+    // date there for the following ones, so that thread is the only writer.
+    // The lock is held exclusively only while the cache is written.
+    std::shared_mutex _cache_lock;
+    std::unique_ptr<StateHistoryCache> _cache;
+    std::atomic<bool> _shutting_down{false};
+    // Whether the cache is being built, and the update the queries wait for,
+    // as long as it hasn't started yet.
+    std::mutex _update_lock;
+    bool _cache_building{false};
+    std::shared_future<void> _queued_update;
+    // Last, so its thread is gone before anything it uses.
+    LogPrefetcher _cache_builder{1};
 
-    // Helper functions to traverse through logfiles
-    logfiles_t::const_iterator _it_logs;
-    const logfile_entries_t *_entries;
-    logfile_entries_t::const_iterator _it_entries;
+    void buildCache();
+    bool cacheIsBuilt();
+    void updateCache();
+    void waitForCache();
+    bool replayIntoCache(StateHistoryCache &cache,
+                         const LogfilesToReplay &logfiles);
+    bool answerQueryFromCache(QueryState &qs);
+    void replayStart(StateHistoryCache &cache,
+                     const std::shared_ptr<const logfiles_t> &logfiles,
+                     time_t until) const;
+    static void processDurations(QueryState &qs, HostServiceState *hs_state,
+                                 const StateHistoryCache::Durations &durations);
+#endif
 
-    void getPreviousLogentry();
-    LogEntry *getNextLogentry();
-    void process(Query *query, HostServiceState *hs_state);
-    int updateHostServiceState(Query *query, const LogEntry *entry,
-                               HostServiceState *hs_state, bool only_update);
+    void replayChunk(QueryState &qs, const std::vector<const LogEntry *> &chunk,
+                     size_t first_index, bool only_update, size_t split) const;
+    void replayChunkInShards(
+        QueryState &qs, std::vector<std::unique_ptr<QueryState>> &shards,
+        const std::vector<const LogEntry *> &chunk, size_t first_index,
+        bool only_update, size_t split, bool finish_all);
+    static void outputPendingRows(
+        QueryState &qs, std::vector<std::unique_ptr<QueryState>> &shards);
+    void replay(QueryState &qs, const LogEntry *entry, bool only_update) const;
+    static void startTimeframe(QueryState &qs);
+    static void finishAll(QueryState &qs, size_t index);
+    static void finish(QueryState &qs, HostServiceState *hst);
+    static void process(QueryState &qs, HostServiceState *hs_state);
+    int updateHostServiceState(QueryState &qs, const LogEntry *entry,
+                               HostServiceState *hs_state,
+                               bool only_update) const;
 };
 
 #endif  // TableStateHistory_h
@@ -30,10 +30,14 @@
 #include "Column.h"
 #include "DoublePointerColumn.h"
 #include "IntPointerColumn.h"
+#include "LogCacheFilesColumn.h"
 #include "Query.h"
 #include "Row.h"
 #include "StatusSpecialIntColumn.h"
 #include "StringPointerColumn.h"
+#ifndef CMC
+#include "TacticalOverviewColumn.h"
+#endif
 #include "TimePointerColumn.h"
 #include "global_counters.h"
 #include "nagios.h"
@@ -58,6 +62,7 @@ extern int enable_flap_detection;
 extern int process_performance_data;
 extern int check_external_commands;
 extern int num_cached_log_messages;
+extern double num_cached_log_bytes;
 extern int interval_length;
 extern int g_num_hosts;
 extern int g_num_services;
@@ -76,7 +81,16 @@ int dummy_int = 0;
 }  // namespace
 #endif  // NAGIOS4
 
-TableStatus::TableStatus(MonitoringCore *mc) : Table(mc) {
+TableStatus::TableStatus(MonitoringCore *mc,
+#ifndef CMC
+                         TacticalOverview *tactical_overview,
+#endif
+                         LogCache *log_cache)
+    : Table(mc)
+#ifndef CMC
+    , _tactical_overview(tactical_overview)
+#endif
+{
     addCounterColumns("neb_callbacks", "NEB callbacks", Counter::neb_callbacks);
     addCounterColumns("requests", "requests to Livestatus", Counter::requests);
     addCounterColumns("connections", "client connections to Livestatus",
@@ -95,6 +109,15 @@ TableStatus::TableStatus(MonitoringCore *mc) : Table(mc) {
         "livecheck_overflows",
         "times a check could not be executed because no livecheck helper was free",
         Counter::livecheck_overflows);
+    addCounterColumns("log_cache_hits",
+                      "logfile accesses answered from the log cache",
+                      Counter::log_cache_hits);
+    addCounterColumns("log_cache_misses",
+                      "logfile accesses which had to read from disk",
+                      Counter::log_cache_misses);
+    addCounterColumns("log_cache_evictions",
+                      "logfiles flushed or trimmed to keep the log cache small",
+                      Counter::log_cache_evictions);
 
     // Nagios program status data
     addColumn(std::make_unique<IntPointerColumn>(
@@ -178,6 +201,58 @@ TableStatus::TableStatus(MonitoringCore *mc) : Table(mc) {
     addColumn(std::make_unique<IntPointerColumn>(
         "num_services", "The total number of services", &g_num_services));
 
+#ifndef CMC
+    // Tactical overview, maintained incrementally and respecting AuthUser
+    addTacticalOverviewColumn("num_hosts_pending", "hosts that are pending",
+                              TacticalOverview::Stat::hosts_pending);
+    addTacticalOverviewColumn("num_hosts_up", "hosts that are up",
+                              TacticalOverview::Stat::hosts_up);
+    addTacticalOverviewColumn("num_hosts_down", "hosts that are down",
+                              TacticalOverview::Stat::hosts_down);
+    addTacticalOverviewColumn("num_hosts_unreach", "hosts that are unreachable",
+                              TacticalOverview::Stat::hosts_unreachable);
+    addTacticalOverviewColumn("num_hosts_problems",
+                              "hosts that are down or unreachable",
+                              TacticalOverview::Stat::hosts_problems);
+    addTacticalOverviewColumn(
+        "num_hosts_unhandled_problems",
+        "host problems that are neither acknowledged nor in a downtime",
+        TacticalOverview::Stat::hosts_unhandled_problems);
+    addTacticalOverviewColumn("num_hosts_acknowledged",
+                              "hosts with an acknowledged problem",
+                              TacticalOverview::Stat::hosts_acknowledged);
+    addTacticalOverviewColumn("num_hosts_in_downtime",
+                              "hosts in a scheduled downtime",
+                              TacticalOverview::Stat::hosts_in_downtime);
+    addTacticalOverviewColumn("num_services_pending",
+                              "services that are pending",
+                              TacticalOverview::Stat::services_pending);
+    addTacticalOverviewColumn("num_services_ok", "services that are OK",
+                              TacticalOverview::Stat::services_ok);
+    addTacticalOverviewColumn("num_services_warn",
+                              "services that are WARNING",
+                              TacticalOverview::Stat::services_warning);
+    addTacticalOverviewColumn("num_services_crit",
+                              "services that are CRITICAL",
+                              TacticalOverview::Stat::services_critical);
+    addTacticalOverviewColumn("num_services_unknown",
+                              "services that are UNKNOWN",
+                              TacticalOverview::Stat::services_unknown);
+    addTacticalOverviewColumn("num_services_problems",
+                              "services that are not OK",
+                              TacticalOverview::Stat::services_problems);
+    addTacticalOverviewColumn(
+        "num_services_unhandled_problems",
+        "service problems that are neither acknowledged nor in a downtime and whose host is up and not in a downtime",
+        TacticalOverview::Stat::services_unhandled_problems);
+    addTacticalOverviewColumn("num_services_acknowledged",
+                              "services with an acknowledged problem",
+                              TacticalOverview::Stat::services_acknowledged);
+    addTacticalOverviewColumn("num_services_in_downtime",
+                              "services in a scheduled downtime",
+                              TacticalOverview::Stat::services_in_downtime);
+#endif
+
     addColumn(std::make_unique<StringPointerColumn>(
         "program_version", "The version of the monitoring daemon",
         get_program_version()));
@@ -216,6 +291,14 @@ TableStatus::TableStatus(MonitoringCore *mc) : Table(mc) {
         "cached_log_messages",
         "The current number of log messages MK Livestatus keeps in memory",
         &num_cached_log_messages));
+    addColumn(std::make_unique<DoublePointerColumn>(
+        "cached_log_bytes",
+        "The current number of bytes used by the log messages MK Livestatus keeps in memory",
+        &num_cached_log_bytes));
+    addColumn(std::make_unique<LogCacheFilesColumn>(
+        "cached_log_files",
+        "The log cache usage of each logfile: name;messages;bytes;hits;misses",
+        log_cache));
     addColumn(std::make_unique<StringPointerColumn>(
         "livestatus_version", "The version of the MK Livestatus module",
         VERSION));
@@ -250,6 +333,15 @@ void TableStatus::addCounterColumns(const std::string &name,
         counterRateAddress(which)));
 }
 
+#ifndef CMC
+void TableStatus::addTacticalOverviewColumn(const std::string &name,
+                                            const std::string &description,
+                                            TacticalOverview::Stat which) {
+    addColumn(std::make_unique<TacticalOverviewColumn>(
+        name, "The number of " + description, _tactical_overview, which));
+}
+#endif
+
 std::string TableStatus::name() const { return "status"; }
 
 std::string TableStatus::namePrefix() const { return "status_"; }
@@ -29,12 +29,20 @@
 #include <string>
 #include "Table.h"
 #include "global_counters.h"
+#ifndef CMC
+#include "TacticalOverview.h"
+#endif
+class LogCache;
 class MonitoringCore;
 class Query;
 
 class TableStatus : public Table {
 public:
-    explicit TableStatus(MonitoringCore *mc);
+    TableStatus(MonitoringCore *mc,
+#ifndef CMC
+                TacticalOverview *tactical_overview,
+#endif
+                LogCache *log_cache);
 
     [[nodiscard]] std::string name() const override;
     [[nodiscard]] std::string namePrefix() const override;
@@ -43,6 +51,13 @@ public:
 private:
     void addCounterColumns(const std::string &name,
                            const std::string &description, Counter which);
+#ifndef CMC
+    void addTacticalOverviewColumn(const std::string &name,
+                                   const std::string &description,
+                                   TacticalOverview::Stat which);
+
+    TacticalOverview *_tactical_overview;
+#endif
 };
 
 #endif  // TableStatus_h
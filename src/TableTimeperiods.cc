@@ -29,6 +29,7 @@
 #include "Query.h"
 #include "Row.h"
 #include "TimeperiodColumn.h"
+#include "TimeperiodTransitionColumn.h"
 #include "nagios.h"
 
 extern timeperiod *timeperiod_list;
@@ -42,6 +43,10 @@ TableTimeperiods::TableTimeperiods(MonitoringCore *mc) : Table(mc) {
         DANGEROUS_OFFSETOF(timeperiod, alias)));
     addColumn(std::make_unique<TimeperiodColumn>(
         "in", "Wether we are currently in this period (0/1)", -1, -1, -1, 0));
+    addColumn(std::make_unique<TimeperiodTransitionColumn>(
+        "next_transition",
+        "The time of the next transition of this period as UNIX timestamp, 0 if not within the next 24 hours",
+        -1, -1, -1, 0));
     // TODO(mk): add days and exceptions
 }
 
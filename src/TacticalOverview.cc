@@ -0,0 +1,224 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#include "TacticalOverview.h"
+#include "auth.h"
+
+extern host *host_list;
+extern service *service_list;
+
+namespace {
+constexpr uint32_t bit(TacticalOverview::Stat stat) {
+    return 1U << static_cast<int>(stat);
+}
+}  // namespace
+
+TacticalOverview::TacticalOverview(MonitoringCore *mc) : _mc(mc), _global{} {}
+
+void TacticalOverview::rebuild() {
+    std::lock_guard<std::mutex> lg(_mutex);
+    _objects.clear();
+    _index.clear();
+    _global.fill(0);
+    _by_contact.clear();
+    for (host *hst = host_list; hst != nullptr; hst = hst->next) {
+        _index[hst] = _objects.size();
+        _objects.push_back({hst, nullptr, statsFor(hst), {}});
+    }
+    for (service *svc = service_list; svc != nullptr; svc = svc->next) {
+        _index[svc] = _objects.size();
+        _objects.push_back({svc->host_ptr, svc, statsFor(svc), {}});
+    }
+    for (const auto &object : _objects) {
+        apply(_global, 0, object._stats);
+    }
+}
+
+void TacticalOverview::updateHost(const host *hst) {
+    auto it = _index.find(hst);
+    if (it == _index.end()) {
+        return;  // not built yet
+    }
+    std::lock_guard<std::mutex> lg(_mutex);
+    update(_objects[it->second]);
+    // The "unhandled" state of services depends on their host.
+    for (servicesmember *mem = hst->services; mem != nullptr;
+         mem = mem->next) {
+        auto sit = _index.find(mem->service_ptr);
+        if (sit != _index.end()) {
+            update(_objects[sit->second]);
+        }
+    }
+}
+
+void TacticalOverview::updateService(const service *svc) {
+    auto it = _index.find(svc);
+    if (it == _index.end()) {
+        return;  // not built yet
+    }
+    std::lock_guard<std::mutex> lg(_mutex);
+    update(_objects[it->second]);
+}
+
+int32_t TacticalOverview::value(Stat which, const contact *auth_user) {
+    if (auth_user == unknown_auth_user()) {
+        return 0;
+    }
+    if (auth_user == nullptr) {
+        std::lock_guard<std::mutex> lg(_mutex);
+        return _global[static_cast<int>(which)];
+    }
+    Counts &counts = countsFor(auth_user);
+    std::lock_guard<std::mutex> lg(_mutex);
+    return counts[static_cast<int>(which)];
+}
+
+void TacticalOverview::update(Object &object) {
+    uint32_t new_stats = object._service == nullptr
+                             ? statsFor(object._host)
+                             : statsFor(object._service);
+    if (new_stats == object._stats) {
+        return;
+    }
+    apply(_global, object._stats, new_stats);
+    for (auto counts : object._watchers) {
+        apply(*counts, object._stats, new_stats);
+    }
+    object._stats = new_stats;
+}
+
+TacticalOverview::Counts &TacticalOverview::countsFor(const contact *ctc) {
+    {
+        std::lock_guard<std::mutex> lg(_mutex);
+        auto it = _by_contact.find(ctc);
+        if (it != _by_contact.end()) {
+            return it->second;
+        }
+    }
+    // The authorization checks only look at the configuration, so we can do
+    // the expensive part without blocking the Nagios thread.
+    std::vector<size_t> authorized;
+    for (size_t i = 0; i < _objects.size(); ++i) {
+        if (is_authorized_for(_mc, ctc, _objects[i]._host,
+                              _objects[i]._service)) {
+            authorized.push_back(i);
+        }
+    }
+    std::lock_guard<std::mutex> lg(_mutex);
+    auto result = _by_contact.emplace(ctc, Counts{});
+    Counts &counts = result.first->second;
+    if (result.second) {  // we might have lost a race against another thread
+        for (auto i : authorized) {
+            _objects[i]._watchers.push_back(&counts);
+            apply(counts, 0, _objects[i]._stats);
+        }
+    }
+    return counts;
+}
+
+// static
+uint32_t TacticalOverview::statsFor(const host *hst) {
+    if (hst->has_been_checked == 0) {
+        return bit(Stat::hosts_pending);
+    }
+    uint32_t stats = 0;
+    switch (hst->current_state) {
+        case HOST_UP:
+            stats |= bit(Stat::hosts_up);
+            break;
+        case HOST_DOWN:
+            stats |= bit(Stat::hosts_down);
+            break;
+        case HOST_UNREACHABLE:
+            stats |= bit(Stat::hosts_unreachable);
+            break;
+    }
+    bool problem = hst->current_state != HOST_UP;
+    bool acknowledged = hst->problem_has_been_acknowledged != 0;
+    bool in_downtime = hst->scheduled_downtime_depth > 0;
+    if (problem) {
+        stats |= bit(Stat::hosts_problems);
+        if (!acknowledged && !in_downtime) {
+            stats |= bit(Stat::hosts_unhandled_problems);
+        }
+    }
+    if (acknowledged) {
+        stats |= bit(Stat::hosts_acknowledged);
+    }
+    if (in_downtime) {
+        stats |= bit(Stat::hosts_in_downtime);
+    }
+    return stats;
+}
+
+// static
+uint32_t TacticalOverview::statsFor(const service *svc) {
+    if (svc->has_been_checked == 0) {
+        return bit(Stat::services_pending);
+    }
+    uint32_t stats = 0;
+    switch (svc->current_state) {
+        case STATE_OK:
+            stats |= bit(Stat::services_ok);
+            break;
+        case STATE_WARNING:
+            stats |= bit(Stat::services_warning);
+            break;
+        case STATE_CRITICAL:
+            stats |= bit(Stat::services_critical);
+            break;
+        case STATE_UNKNOWN:
+            stats |= bit(Stat::services_unknown);
+            break;
+    }
+    const host *hst = svc->host_ptr;
+    bool problem = svc->current_state != STATE_OK;
+    bool acknowledged = svc->problem_has_been_acknowledged != 0;
+    bool in_downtime = svc->scheduled_downtime_depth > 0;
+    if (problem) {
+        stats |= bit(Stat::services_problems);
+        if (!acknowledged && !in_downtime &&
+            hst->scheduled_downtime_depth == 0 &&
+            hst->current_state == HOST_UP) {
+            stats |= bit(Stat::services_unhandled_problems);
+        }
+    }
+    if (acknowledged) {
+        stats |= bit(Stat::services_acknowledged);
+    }
+    if (in_downtime) {
+        stats |= bit(Stat::services_in_downtime);
+    }
+    return stats;
+}
+
+// static
+void TacticalOverview::apply(Counts &counts, uint32_t old_stats,
+                             uint32_t new_stats) {
+    for (size_t i = 0; i < num_stats; ++i) {
+        auto mask = 1U << i;
+        counts[i] += ((new_stats & mask) != 0 ? 1 : 0) -
+                     ((old_stats & mask) != 0 ? 1 : 0);
+    }
+}
@@ -0,0 +1,107 @@
+// +------------------------------------------------------------------+
+// |             ____ _               _        __  __ _  __           |
+// |            / ___| |__   ___  ___| | __   |  \/  | |/ /           |
+// |           | |   | '_ \ / _ \/ __| |/ /   | |\/| | ' /            |
+// |           | |___| | | |  __/ (__|   <    | |  | | . \            |
+// |            \____|_| |_|\___|\___|_|\_\___|_|  |_|_|\_\           |
+// |                                                                  |
+// | Copyright Mathias Kettner 2014             mk@mathias-kettner.de |
+// +------------------------------------------------------------------+
+//
+// This file is part of Check_MK.
+// The official homepage is at http://mathias-kettner.de/check_mk.
+//
+// check_mk is free software;  you can redistribute it and/or modify it
+// under the  terms of the  GNU General Public License  as published by
+// the Free Software Foundation in version 2.  check_mk is  distributed
+// in the hope that it will be useful, but WITHOUT ANY WARRANTY;  with-
+// out even the implied warranty of  MERCHANTABILITY  or  FITNESS FOR A
+// PARTICULAR PURPOSE. See the  GNU General Public License for more de-
+// tails. You should have  received  a copy of the  GNU  General Public
+// License along with GNU Make; see the file  COPYING.  If  not,  write
+// to the Free Software Foundation, Inc., 51 Franklin St,  Fifth Floor,
+// Boston, MA 02110-1301 USA.
+
+#ifndef TacticalOverview_h
+#define TacticalOverview_h
+
+#include "config.h"  // IWYU pragma: keep
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "nagios.h"
+class MonitoringCore;
+
+/// Host and service counts for the "tactical overview", kept up to date from
+/// the status NEB callbacks instead of scanning host_list/service_list.
+class TacticalOverview {
+public:
+    // Remember to update num_stats when you change the enum below.
+    enum class Stat {
+        hosts_pending,
+        hosts_up,
+        hosts_down,
+        hosts_unreachable,
+        hosts_problems,
+        hosts_unhandled_problems,
+        hosts_acknowledged,
+        hosts_in_downtime,
+        services_pending,
+        services_ok,
+        services_warning,
+        services_critical,
+        services_unknown,
+        services_problems,
+        services_unhandled_problems,
+        services_acknowledged,
+        services_in_downtime
+    };
+    static constexpr size_t num_stats = 17;
+
+    explicit TacticalOverview(MonitoringCore *mc);
+
+    // Must be called from the Nagios thread.
+    void rebuild();
+    void updateHost(const host *hst);
+    void updateService(const service *svc);
+
+    // Can be called from any thread. A nullptr auth_user means no
+    // restrictions, otherwise only objects the contact is authorized for are
+    // counted. The per-contact counters are built on first use and maintained
+    // incrementally afterwards.
+    int32_t value(Stat which, const contact *auth_user);
+
+private:
+    using Counts = std::array<int32_t, num_stats>;
+
+    struct Object {
+        const host *_host;
+        const service *_service;  // nullptr for host objects
+        uint32_t _stats;
+        std::vector<Counts *> _watchers;
+    };
+
+    MonitoringCore *const _mc;
+
+    // Only modified by rebuild(), so it is safe to read it without holding
+    // _mutex from other threads once the client threads are running.
+    std::vector<Object> _objects;
+    std::unordered_map<const void *, size_t> _index;
+
+    // The mutex protects the stats of _objects, their watchers, _global and
+    // _by_contact.
+    std::mutex _mutex;
+    Counts _global;
+    std::unordered_map<const contact *, Counts> _by_contact;
+
+    void update(Object &object);
+    Counts &countsFor(const contact *ctc);
+    static uint32_t statsFor(const host *hst);
+    static uint32_t statsFor(const service *svc);
+    static void apply(Counts &counts, uint32_t old_stats, uint32_t new_stats);
+};
+
+#endif  // TacticalOverview_h
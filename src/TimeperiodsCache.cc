@@ -23,88 +23,221 @@
 // Boston, MA 02110-1301 USA.
 
 #include "TimeperiodsCache.h"
+#include <algorithm>
+#include <limits>
 #include <ostream>
-#include <string>
-#include <type_traits>
 #include <utility>
 #include "Logger.h"
 
 extern timeperiod *timeperiod_list;
 
-TimeperiodsCache::TimeperiodsCache(Logger *logger) : _logger(logger) {}
+namespace {
+// How far into the future we compute transitions. The timeperiod definitions
+// have a 1-minute granularity, so we probe once a minute.
+constexpr time_t schedule_horizon = 24 * 60 * 60;
+constexpr time_t schedule_resolution = 60;
+// Recompute the schedule when less than this is left of it.
+constexpr time_t schedule_margin = 60 * 60;
+// How many probes a timed event spends on the next schedule.
+constexpr size_t max_probes_per_update = 1000;
+
+std::atomic<uint64_t> last_generation{0};
+
+// The snapshot a client thread has looked at last.
+struct SnapshotReference {
+    uint64_t _generation = 0;
+    std::shared_ptr<const void> _snapshot;
+};
+thread_local SnapshotReference tl_snapshot;
+}  // namespace
+
+TimeperiodsCache::TimeperiodsCache(Logger *logger)
+    : _logger(logger), _generation(0) {}
+
+TimeperiodsCache::~TimeperiodsCache() = default;
+
+bool TimeperiodsCache::Schedule::isActive(time_t t) const {
+    auto passed =
+        std::upper_bound(_transitions.begin(), _transitions.end(), t) -
+        _transitions.begin();
+    return _in_at_start != (passed % 2 == 1);
+}
+
+time_t TimeperiodsCache::Schedule::nextTransition(time_t t) const {
+    auto it = std::upper_bound(_transitions.begin(), _transitions.end(), t);
+    return it == _transitions.end() ? 0 : *it;
+}
 
 void TimeperiodsCache::logCurrentTimeperiods() {
-    std::lock_guard<std::mutex> lg(_mutex);
-    // Loop over all timeperiods and compute if we are currently in. Detect the
-    // case where no time periods are known (yet!). This might be the case when
-    // a timed event broker message arrives *before* the start of the event
-    // loop.
+    // Loop over all timeperiods and log their current state, also remembering
+    // it for detecting transitions later.
     auto now =
         std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    auto current = snapshot();
     for (timeperiod *tp = timeperiod_list; tp != nullptr; tp = tp->next) {
-        bool is_in = check_time_against_period(now, tp) == 0;
-        // check previous state and log transition if state has changed
-        auto it = _cache.find(tp);
-        if (it == _cache.end()) {  // first entry
-            logTransition(tp->name, -1, is_in ? 1 : 0);
-            _cache.emplace(tp, is_in);
-        }
-        logTransition(tp->name, it->second ? 1 : 0, is_in ? 1 : 0);
+        const Schedule *schedule = scheduleFor(current.get(), tp);
+        bool is_in = schedule == nullptr
+                         ? check_time_against_period(now, tp) == 0
+                         : schedule->isActive(now);
+        auto it = _logged_state.find(tp);
+        logTransition(tp->name,
+                      it == _logged_state.end() ? -1 : (it->second ? 1 : 0),
+                      is_in ? 1 : 0);
+        _logged_state[tp] = is_in;
     }
 }
 
 void TimeperiodsCache::update(std::chrono::system_clock::time_point now) {
-    std::lock_guard<std::mutex> lg(_mutex);
-    // Update cache only once a minute. The timeperiod definitions have a
-    // 1-minute granularity, so a 1-second resultion is not needed.
+    auto t = std::chrono::system_clock::to_time_t(now);
+    // Detect the case where no time periods are known (yet!). This might be
+    // the case when a timed event broker message arrives *before* the start of
+    // the event loop.
+    if (timeperiod_list == nullptr) {
+        Informational(_logger)
+            << "Timeperiod cache not updated, there are no timeperiods (yet)";
+        return;
+    }
+    auto current = snapshot();
+    if (!current || current->_by_timeperiod.empty() || t < current->_start ||
+        t >= current->_horizon) {
+        // Nothing valid to look at, so we can't spread the work.
+        startComputation(t);
+        continueComputation(std::numeric_limits<size_t>::max());
+        current = snapshot();
+    } else if (_computation || t + schedule_margin > current->_horizon) {
+        if (!_computation) {
+            startComputation(t);
+        }
+        if (continueComputation(max_probes_per_update)) {
+            current = snapshot();
+        }
+    }
+
+    // Transitions are logged only once a minute, that's the granularity of
+    // the timeperiod definitions anyway.
     if (now < _last_update + std::chrono::minutes(1)) {
         return;
     }
     _last_update = now;
-
-    // Loop over all timeperiods and compute if we are currently in. Detect the
-    // case where no time periods are known (yet!). This might be the case when
-    // a timed event broker message arrives *before* the start of the event
-    // loop.
     for (timeperiod *tp = timeperiod_list; tp != nullptr; tp = tp->next) {
-        bool is_in = check_time_against_period(
-                         std::chrono::system_clock::to_time_t(now), tp) == 0;
+        const Schedule *schedule = scheduleFor(current.get(), tp);
+        if (schedule == nullptr) {
+            continue;
+        }
+        bool is_in = schedule->isActive(t);
         // check previous state and log transition if state has changed
-        auto it = _cache.find(tp);
-        if (it == _cache.end()) {  // first entry
+        auto it = _logged_state.find(tp);
+        if (it == _logged_state.end()) {  // first entry
             logTransition(tp->name, -1, is_in ? 1 : 0);
-            _cache.emplace(tp, is_in);
+            _logged_state.emplace(tp, is_in);
         } else if (it->second != is_in) {
             logTransition(tp->name, it->second ? 1 : 0, is_in ? 1 : 0);
             it->second = is_in;
         }
     }
-    if (timeperiod_list != nullptr) {
-        Informational(_logger)
-            << "Timeperiod cache not updated, there are no timeperiods (yet)";
+}
+
+void TimeperiodsCache::publish(std::shared_ptr<const Snapshot> snapshot) {
+    Debug(_logger) << "computed schedule for "
+                   << snapshot->_by_timeperiod.size() << " timeperiods";
+    // Client threads still looking at the old snapshot keep it alive.
+    std::lock_guard<std::mutex> lg(_lock);
+    _snapshot = std::move(snapshot);
+    _generation = ++last_generation;
+}
+
+void TimeperiodsCache::startComputation(time_t start) {
+    auto snapshot = std::make_shared<Snapshot>();
+    start -= start % schedule_resolution;
+    snapshot->_start = start;
+    snapshot->_horizon = start + schedule_horizon;
+    _computation = std::make_unique<Computation>(
+        Computation{std::move(snapshot), timeperiod_list, start, {}, false});
+}
+
+// Probes the timeperiods once a minute up to the horizon, but at most the
+// given number of times. Returns true when the snapshot has been published.
+bool TimeperiodsCache::continueComputation(size_t max_probes) {
+    auto &c = *_computation;
+    for (size_t probes = 0; c._tp != nullptr; probes++) {
+        if (probes == max_probes) {
+            return false;
+        }
+        bool now_in = check_time_against_period(c._next_probe, c._tp) == 0;
+        if (c._next_probe == c._snapshot->_start) {
+            c._schedule = Schedule{now_in, {}};
+        } else if (now_in != c._is_in) {
+            c._schedule._transitions.push_back(c._next_probe);
+        }
+        c._is_in = now_in;
+        c._next_probe += schedule_resolution;
+        if (c._next_probe > c._snapshot->_horizon) {
+            auto &entry = c._snapshot->_by_timeperiod[c._tp] =
+                std::move(c._schedule);
+            c._snapshot->_by_name.emplace(c._tp->name, &entry);
+            c._tp = c._tp->next;
+            c._next_probe = c._snapshot->_start;
+        }
     }
+    publish(std::move(c._snapshot));
+    _computation.reset();
+    return true;
+}
+
+// Only the first look at a new snapshot takes the lock.
+std::shared_ptr<const TimeperiodsCache::Snapshot> TimeperiodsCache::snapshot()
+    const {
+    auto generation = _generation.load();
+    if (tl_snapshot._generation != generation) {
+        std::lock_guard<std::mutex> lg(_lock);
+        tl_snapshot = {_generation, _snapshot};
+    }
+    return std::static_pointer_cast<const Snapshot>(tl_snapshot._snapshot);
+}
+
+// static
+const TimeperiodsCache::Schedule *TimeperiodsCache::scheduleFor(
+    const Snapshot *snapshot, const timeperiod *tp) {
+    if (snapshot == nullptr) {
+        return nullptr;
+    }
+    auto it = snapshot->_by_timeperiod.find(tp);
+    return it == snapshot->_by_timeperiod.end() ? nullptr : &it->second;
 }
 
 bool TimeperiodsCache::inTimeperiod(const std::string &tpname) const {
-    for (timeperiod *tp = timeperiod_list; tp != nullptr; tp = tp->next) {
-        if (tpname == tp->name) {
-            return inTimeperiod(tp);
-        }
+    auto current = snapshot();
+    if (!current) {
+        return true;  // no information yet, assume 24X7
+    }
+    auto it = current->_by_name.find(tpname);
+    if (it == current->_by_name.end()) {
+        return true;  // unknown timeperiod is assumed to be 24X7
     }
-    return true;  // unknown timeperiod is assumed to be 24X7
+    return it->second->isActive(time(nullptr));
 }
 
 bool TimeperiodsCache::inTimeperiod(const timeperiod *tp) const {
-    std::lock_guard<std::mutex> lg(_mutex);
-    auto it = _cache.find(tp);
-    if (it == _cache.end()) {
+    auto current = snapshot();
+    const Schedule *schedule = scheduleFor(current.get(), tp);
+    if (schedule == nullptr) {
         // Problem: check_time_against_period is not thread safe, so we can't
         // use it here.
         Informational(_logger) << "No timeperiod information available for "
                                << tp->name << ". Assuming out of period.";
         return false;
     }
-    return it->second;
+    return schedule->isActive(time(nullptr));
+}
+
+std::chrono::system_clock::time_point TimeperiodsCache::nextTransition(
+    const timeperiod *tp) const {
+    auto current = snapshot();
+    const Schedule *schedule = scheduleFor(current.get(), tp);
+    time_t next =
+        schedule == nullptr ? 0 : schedule->nextTransition(time(nullptr));
+    return next == 0 ? std::chrono::system_clock::time_point{}
+                     : std::chrono::system_clock::from_time_t(next);
 }
 
 void TimeperiodsCache::logTransition(char *name, int from, int to) const {
@@ -26,29 +26,92 @@
 #define TimeperiodsCache_h
 
 #include "config.h"  // IWYU pragma: keep
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "nagios.h"
 class Logger;
 
+/// Precomputed timeperiod transitions. The schedule is computed on the Nagios
+/// thread (check_time_against_period is not thread-safe) and published as an
+/// immutable snapshot, so client threads can look up states without locking.
+/// Each client thread keeps its own reference to the current snapshot and
+/// only takes a lock to get the next one after it has been replaced.
+///
+/// The first schedule is computed in one go when the event loop starts, which
+/// takes a minute's worth of probes for each timeperiod for the whole horizon.
+/// Later ones are computed a few probes per timed event ahead of time.
 class TimeperiodsCache {
 public:
     explicit TimeperiodsCache(Logger *logger);
+    ~TimeperiodsCache();
+
+    // Must be called from the Nagios thread.
     void update(std::chrono::system_clock::time_point now);
+    void logCurrentTimeperiods();
+
+    // Can be called from any thread.
     bool inTimeperiod(const timeperiod *tp) const;
     bool inTimeperiod(const std::string &tpname) const;
-    void logCurrentTimeperiods();
+    // The time of the next transition or time_point{} if there is none within
+    // the precomputed horizon.
+    [[nodiscard]] std::chrono::system_clock::time_point nextTransition(
+        const timeperiod *tp) const;
 
 private:
+    struct Schedule {
+        bool _in_at_start;
+        std::vector<time_t> _transitions;  // ascending, after _start
+
+        [[nodiscard]] bool isActive(time_t t) const;
+        [[nodiscard]] time_t nextTransition(time_t t) const;
+    };
+
+    struct Snapshot {
+        time_t _start;
+        time_t _horizon;
+        std::unordered_map<const timeperiod *, Schedule> _by_timeperiod;
+        std::unordered_map<std::string, const Schedule *> _by_name;
+    };
+
+    // A snapshot being computed, the probes continue at the given timeperiod
+    // and time.
+    struct Computation {
+        std::shared_ptr<Snapshot> _snapshot;
+        timeperiod *_tp;
+        time_t _next_probe;
+        Schedule _schedule;
+        bool _is_in;
+    };
+
     Logger *const _logger;
 
-    // The mutex protects _last_update and _cache.
-    mutable std::mutex _mutex;
+    // The current snapshot, replaced by the Nagios thread only. The
+    // generation changes with each replacement, it is unique among all
+    // snapshots of all instances.
+    mutable std::mutex _lock;
+    std::shared_ptr<const Snapshot> _snapshot;
+    std::atomic<uint64_t> _generation;
+
+    // Only used by the Nagios thread.
     std::chrono::system_clock::time_point _last_update;
-    std::map<const timeperiod *, bool> _cache;
+    std::map<const timeperiod *, bool> _logged_state;
+    std::unique_ptr<Computation> _computation;
 
+    void publish(std::shared_ptr<const Snapshot> snapshot);
+    void startComputation(time_t start);
+    bool continueComputation(size_t max_probes);
+    [[nodiscard]] std::shared_ptr<const Snapshot> snapshot() const;
+    static const Schedule *scheduleFor(const Snapshot *snapshot,
+                                       const timeperiod *tp);
     void logTransition(char *name, int from, int to) const;
 };
 
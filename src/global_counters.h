@@ -40,7 +40,10 @@ enum class Counter {
     commands,
     livechecks,
     livecheck_overflows,
-    overflows
+    overflows,
+    log_cache_hits,
+    log_cache_misses,
+    log_cache_evictions
 };
 
 void counterIncrement(Counter which);
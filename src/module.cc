@@ -112,6 +112,7 @@ struct ThreadInfo {
 static std::vector<ThreadInfo> fl_thread_info;
 static thread_local ThreadInfo *tl_info;
 size_t fl_max_cached_messages = 500000;
+size_t fl_max_cached_log_bytes = 256 * 1024 * 1024;
 // do never read more than that number of lines from a logfile
 static size_t fl_max_lines_per_logfile = 1000000;
 size_t fl_max_response_size = 100 * 1024 * 1024;  // limit answer to 10 MB
@@ -450,8 +451,24 @@ void close_unix_socket() {
     }
 }
 
-int broker_host(int event_type __attribute__((__unused__)),
-                void *data __attribute__((__unused__))) {
+int broker_host(int event_type __attribute__((__unused__)), void *data) {
+    auto hs = static_cast<nebstruct_host_status_data *>(data);
+    if (fl_store != nullptr) {
+        auto hst = static_cast<host *>(hs->object_ptr);
+        fl_store->_tactical_overview.updateHost(hst);
+        fl_store->_state_aggregates.update(hst);
+    }
+    counterIncrement(Counter::neb_callbacks);
+    return 0;
+}
+
+int broker_service(int event_type __attribute__((__unused__)), void *data) {
+    auto ss = static_cast<nebstruct_service_status_data *>(data);
+    if (fl_store != nullptr) {
+        auto svc = static_cast<service *>(ss->object_ptr);
+        fl_store->_tactical_overview.updateService(svc);
+        fl_store->_state_aggregates.update(svc);
+    }
     counterIncrement(Counter::neb_callbacks);
     return 0;
 }
@@ -462,11 +479,19 @@ int broker_check(int event_type, void *data) {
         auto c = static_cast<nebstruct_service_check_data *>(data);
         if (c->type == NEBTYPE_SERVICECHECK_PROCESSED) {
             counterIncrement(Counter::service_checks);
+            if (fl_store != nullptr) {
+                fl_store->_state_aggregates.update(
+                    static_cast<service *>(c->object_ptr));
+            }
         }
     } else if (event_type == NEBCALLBACK_HOST_CHECK_DATA) {
         auto c = static_cast<nebstruct_host_check_data *>(data);
         if (c->type == NEBTYPE_HOSTCHECK_PROCESSED) {
             counterIncrement(Counter::host_checks);
+            if (fl_store != nullptr) {
+                fl_store->_state_aggregates.update(
+                    static_cast<host *>(c->object_ptr));
+            }
         }
     }
     fl_triggers.notify_all(Triggers::Kind::check);
@@ -489,8 +514,11 @@ int broker_downtime(int event_type __attribute__((__unused__)), void *data) {
     return 0;
 }
 
-int broker_log(int event_type __attribute__((__unused__)),
-               void *data __attribute__((__unused__))) {
+int broker_log(int event_type __attribute__((__unused__)), void *data) {
+    auto ld = static_cast<nebstruct_log_data *>(data);
+    if (fl_store != nullptr) {
+        fl_store->logCache()->logLineWritten(ld->entry_time, ld->data);
+    }
     counterIncrement(Counter::neb_callbacks);
     counterIncrement(Counter::log_messages);
     fl_triggers.notify_all(Triggers::Kind::log);
@@ -514,8 +542,17 @@ int broker_command(int event_type __attribute__((__unused__)), void *data) {
     return 0;
 }
 
-int broker_state(int event_type __attribute__((__unused__)),
-                 void *data __attribute__((__unused__))) {
+int broker_state(int event_type __attribute__((__unused__)), void *data) {
+    auto sc = static_cast<nebstruct_statechange_data *>(data);
+    if (fl_store != nullptr) {
+        if (sc->statechange_type == HOST_STATECHANGE) {
+            fl_store->_state_aggregates.update(
+                static_cast<host *>(sc->object_ptr));
+        } else if (sc->statechange_type == SERVICE_STATECHANGE) {
+            fl_store->_state_aggregates.update(
+                static_cast<service *>(sc->object_ptr));
+        }
+    }
     counterIncrement(Counter::neb_callbacks);
     fl_triggers.notify_all(Triggers::Kind::state);
     return 0;
@@ -661,6 +698,7 @@ public:
     Encoding dataEncoding() override { return fl_data_encoding; }
     size_t maxResponseSize() override { return fl_max_response_size; }
     size_t maxCachedMessages() override { return fl_max_cached_messages; }
+    size_t maxCachedLogBytes() override { return fl_max_cached_log_bytes; }
 
     // TODO(sp) Unused in Livestatus NEB: Strange & ugly...
     [[nodiscard]] AuthorizationKind hostAuthorization() const override {
@@ -709,11 +747,9 @@ private:
     std::vector<DowntimeData> downtimes_for_object(const ::host *h,
                                                    const ::service *s) const {
         std::vector<DowntimeData> result;
-        for (const auto &entry : fl_store->_downtimes) {
-            auto *dt = static_cast<Downtime *>(entry.second.get());
-            if (dt->_host == h && dt->_service == s) {
-                result.push_back({dt->_id, dt->_author_name, dt->_comment});
-            }
+        for (const auto &entry : fl_store->_downtimes.forObject(h, s)) {
+            auto *dt = static_cast<const Downtime *>(entry.second);
+            result.push_back({dt->_id, dt->_author_name, dt->_comment});
         }
         return result;
     }
@@ -721,14 +757,12 @@ private:
     std::vector<CommentData> comments_for_object(const ::host *h,
                                                  const ::service *s) const {
         std::vector<CommentData> result;
-        for (const auto &entry : fl_store->_comments) {
-            auto *co = static_cast<Comment *>(entry.second.get());
-            if (co->_host == h && co->_service == s) {
-                result.push_back(
-                    {co->_id, co->_author_name, co->_comment,
-                     static_cast<uint32_t>(co->_entry_type),
-                     std::chrono::system_clock::from_time_t(co->_entry_time)});
-            }
+        for (const auto &entry : fl_store->_comments.forObject(h, s)) {
+            auto *co = static_cast<const Comment *>(entry.second);
+            result.push_back(
+                {co->_id, co->_author_name, co->_comment,
+                 static_cast<uint32_t>(co->_entry_type),
+                 std::chrono::system_clock::from_time_t(co->_entry_time)});
         }
         return result;
     }
@@ -755,6 +789,9 @@ int broker_process(int event_type __attribute__((__unused__)), void *data) {
             break;
         case NEBTYPE_PROCESS_EVENTLOOPSTART:
             g_timeperiods_cache->update(from_timeval(ps->timestamp));
+            fl_store->_tactical_overview.rebuild();
+            fl_store->_state_aggregates.rebuild();
+            fl_store->_group_membership.rebuild();
             start_threads();
             break;
         default:
@@ -838,6 +875,8 @@ int verify_event_broker_options() {
 void register_callbacks() {
     neb_register_callback(NEBCALLBACK_HOST_STATUS_DATA, g_nagios_handle, 0,
                           broker_host);  // Needed to start threads
+    neb_register_callback(NEBCALLBACK_SERVICE_STATUS_DATA, g_nagios_handle, 0,
+                          broker_service);  // for the tactical overview
     neb_register_callback(NEBCALLBACK_COMMENT_DATA, g_nagios_handle, 0,
                           broker_comment);  // dynamic data
     neb_register_callback(NEBCALLBACK_DOWNTIME_DATA, g_nagios_handle, 0,
@@ -847,7 +886,7 @@ void register_callbacks() {
     neb_register_callback(NEBCALLBACK_HOST_CHECK_DATA, g_nagios_handle, 0,
                           broker_check);  // only for statistics
     neb_register_callback(NEBCALLBACK_LOG_DATA, g_nagios_handle, 0,
-                          broker_log);  // only for trigger 'log'
+                          broker_log);  // trigger 'log' and log cache
     neb_register_callback(NEBCALLBACK_EXTERNAL_COMMAND_DATA, g_nagios_handle, 0,
                           broker_command);  // only for trigger 'command'
     neb_register_callback(NEBCALLBACK_STATE_CHANGE_DATA, g_nagios_handle, 0,
@@ -862,6 +901,7 @@ void register_callbacks() {
 
 void deregister_callbacks() {
     neb_deregister_callback(NEBCALLBACK_HOST_STATUS_DATA, broker_host);
+    neb_deregister_callback(NEBCALLBACK_SERVICE_STATUS_DATA, broker_service);
     neb_deregister_callback(NEBCALLBACK_COMMENT_DATA, broker_comment);
     neb_deregister_callback(NEBCALLBACK_DOWNTIME_DATA, broker_downtime);
     neb_deregister_callback(NEBCALLBACK_SERVICE_CHECK_DATA, broker_check);
@@ -941,6 +981,11 @@ void livestatus_parse_arguments(const char *args_orig) {
                 Notice(fl_logger_nagios)
                     << "setting max number of cached log messages to "
                     << fl_max_cached_messages;
+            } else if (strcmp(left, "max_cached_log_bytes") == 0) {
+                fl_max_cached_log_bytes = strtoul(right, nullptr, 10);
+                Notice(fl_logger_nagios)
+                    << "setting max number of bytes of cached log messages to "
+                    << fl_max_cached_log_bytes;
             } else if (strcmp(left, "max_lines_per_logfile") == 0) {
                 fl_max_lines_per_logfile = strtoul(right, nullptr, 10);
                 Notice(fl_logger_nagios)